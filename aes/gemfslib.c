@@ -42,7 +42,13 @@
 
 #define LEN_FSNAME (LEN_ZFNAME+1)   /* includes leading flag byte & trailing nul */
 #define LEN_FSPATH  (LEN_ZPATH+4)   /* at least 3 bytes longer than max path */
-#define LEN_FSWORK  (3*LEN_FSPATH)  /* total workarea length in fs_input() */
+#if CONF_WITH_FSLIST
+#define NM_FSLIST   16              /* entries returned per dos_slist() call */
+#define LEN_FSLIST  (sizeof(FSLIST)+NM_FSLIST*sizeof(FSENTRY))
+#else
+#define LEN_FSLIST  0
+#endif
+#define LEN_FSWORK  (3*LEN_FSPATH+LEN_FSLIST)   /* total workarea length in fs_input() */
 
 static GRECT gl_rfs;
 
@@ -51,6 +57,9 @@ static const char gl_fsobj[4] = {FTITLE, FILEBOX, SCRLBAR, 0x0};
 static char *ad_fsnames;    /* holds filenames in currently-displayed directory */
 static LONG *g_fslist;      /* offsets of filenames within ad_fsnames */
 static LONG nm_files;       /* total number of slots in g_fslist[] */
+#if CONF_WITH_FSLIST
+static FSLIST *fs_listbuf;  /* buffer for dos_slist() */
+#endif
 
 
 /*
@@ -246,13 +255,13 @@ static WORD fs_comp(char *name1, char *name2)
 }
 
 
-static LONG fs_add(WORD thefile, LONG fs_index)
+static LONG fs_add(WORD thefile, LONG fs_index, char attr, const char *name)
 {
     WORD len;
 
     g_fslist[thefile] = fs_index;
-    ad_fsnames[fs_index++] = (D.g_dta.d_attrib & FA_SUBDIR) ? 0x07 : ' ';
-    len = strlencpy(ad_fsnames+fs_index,D.g_dta.d_fname);
+    ad_fsnames[fs_index++] = (attr & FA_SUBDIR) ? 0x07 : ' ';
+    len = strlencpy(ad_fsnames+fs_index,name);
     fs_index += len + 1;
     return fs_index;
 }
@@ -271,7 +280,12 @@ static WORD fs_active(char *ppath, char *pspec, WORD *pcount)
     LONG thefile, fs_index, temp;
     WORD i, j, gap;
     char *fname, allpath[LEN_ZPATH+1];
+#if CONF_WITH_FSLIST
+    FSENTRY *fe;
+    LONG n;
+#endif
     DTA *user_dta;
+    BOOL fallback = TRUE;
 
     set_mouse_to_hourglass();
 
@@ -282,32 +296,72 @@ static WORD fs_active(char *ppath, char *pspec, WORD *pcount)
     fname = fs_pspec(allpath,NULL);
     set_all_files(fname);
 
-    user_dta = dos_gdta();          /* remember user's DTA */
-    dos_sdta(&D.g_dta);
-    ret = dos_sfirst(allpath, FA_SUBDIR);
-
     /*
      * like Atari TOS, we silently ignore any filenames that we don't
      * have room for.  this should be an extremely rare occurrence.
+     *
+     * if dos_slist() is not available (EINVFN from a GEMDOS that lacks
+     * it), we use dos_sfirst()/dos_snext() instead.
      */
-    while((ret == 0) && (thefile < nm_files))
+#if CONF_WITH_FSLIST
+    ret = 0;
+    fs_listbuf->fl_cookie = 0L;
+    while (thefile < nm_files)
     {
-        /* if it is a real file or directory then save it and set
-         * the first byte to tell which
-         */
-        if (D.g_dta.d_fname[0] != '.')
+        n = dos_slist(allpath, FA_SUBDIR, fs_listbuf, LEN_FSLIST);
+        if (n < 0L)
         {
-            if ((D.g_dta.d_attrib & FA_SUBDIR) || (wildcmp(pspec, D.g_dta.d_fname)))
+            ret = (WORD)n;
+            break;
+        }
+        for (fe = (FSENTRY *)(fs_listbuf+1); n && (thefile < nm_files); n--, fe++)
+        {
+            if (fe->fe_name[0] == '.')
+                continue;
+            if ((fe->fe_attr & FA_SUBDIR) || (wildcmp(pspec, fe->fe_name)))
             {
-                fs_index = fs_add(thefile, fs_index);
+                fs_index = fs_add(thefile, fs_index, fe->fe_attr, fe->fe_name);
                 thefile++;
             }
         }
-        ret = dos_snext();
+        if (fs_listbuf->fl_cookie == 0L)    /* end of directory */
+            break;
+    }
+
+    fallback = (ret == EINVFN);
+    if (fallback)                   /* discard anything we have so far */
+    {
+        thefile = 0L;
+        fs_index = 0L;
+    }
+#endif
+
+    if (fallback)
+    {
+        user_dta = dos_gdta();      /* remember user's DTA */
+        dos_sdta(&D.g_dta);
+        ret = dos_sfirst(allpath, FA_SUBDIR);
+
+        while((ret == 0) && (thefile < nm_files))
+        {
+            /* if it is a real file or directory then save it and set
+             * the first byte to tell which
+             */
+            if (D.g_dta.d_fname[0] != '.')
+            {
+                if ((D.g_dta.d_attrib & FA_SUBDIR) || (wildcmp(pspec, D.g_dta.d_fname)))
+                {
+                    fs_index = fs_add(thefile, fs_index, D.g_dta.d_attrib, D.g_dta.d_fname);
+                    thefile++;
+                }
+            }
+            ret = dos_snext();
+        }
+
+        dos_sdta(user_dta);         /* restore user DTA */
     }
 
     *pcount = thefile;
-    dos_sdta(user_dta);             /* restore user DTA */
 
     /* sort files using shell sort from page 108 of K&R C Prog. Lang. */
     for (gap = thefile/2; gap > 0; gap /= 2)
@@ -327,7 +381,7 @@ static WORD fs_active(char *ppath, char *pspec, WORD *pcount)
 
     set_mouse_to_arrow();
 
-    if ((ret == EFILNF) || (ret == ENMFIL))
+    if ((ret == 0) || (ret == EFILNF) || (ret == ENMFIL))
         return TRUE;
 
     if (!IS_BIOS_ERROR(ret))    /* if BDOS error, issue message via form_error(): */
@@ -645,6 +699,7 @@ WORD fs_input(char *pipath, char *pisel, WORD *pbutton, char *pilabel)
      * (this also happily reduces code size).
      *
      * the order of data within the gotten area is:
+     *  dos_slist() buffer (if CONF_WITH_FSLIST)
      *  filename pointers
      *  filename array
      *  locstr
@@ -661,7 +716,10 @@ WORD fs_input(char *pipath, char *pisel, WORD *pbutton, char *pilabel)
         return FALSE;
     }
 
-    g_fslist = (LONG *)memblk;
+#if CONF_WITH_FSLIST
+    fs_listbuf = (FSLIST *)memblk;
+#endif
+    g_fslist = (LONG *)(memblk+LEN_FSLIST);
     ad_fsnames = (char *)(g_fslist+nm_files);
     locstr = ad_fsnames + (nm_files * LEN_FSNAME);
     locold = locstr + LEN_FSPATH;
@@ -29,6 +29,7 @@
 #include "biosbind.h"
 #include "string.h"
 #include "bdosstub.h"
+#include "biosext.h"
 #include "tosvars.h"
 
 /*
@@ -49,6 +50,7 @@ PFVOID old_trap2; /* Old trap #2 handler, also used by rwa.S */
 
 static long ni(void);
 static long xgetver(void);
+static long xsstat(int which, void *buf, long len);
 
 
 /*
@@ -282,7 +284,28 @@ static const FND funcs[] =
     { NI, 0, 0 },
 
     { F(xrename),  0, 5 },      /* 0x56 */
-    { F(xgsdtof),  0, 4 }       /* 0x57 */
+    { F(xgsdtof),  0, 4 },      /* 0x57 */
+
+    /*
+     * EmuTOS extensions
+     */
+
+    { F(xsstat),   0, 5 },      /* 0x58 */
+#if CONF_WITH_FSLIST
+    { F(xslist),   0, 7 },      /* 0x59 */
+#else
+    { NI, 0, 0 },               /* 0x59 */
+#endif
+#if CONF_WITH_FCOPY
+    { F(xfcopy),   0, 4 },      /* 0x5A */
+#else
+    { NI, 0, 0 },               /* 0x5A */
+#endif
+#if CONF_WITH_BESTFIT
+    { F(xmpolicy), 0, 1 }       /* 0x5B */
+#else
+    { NI, 0, 0 }                /* 0x5B */
+#endif
 #undef F
 #undef NI
 };
@@ -299,6 +322,87 @@ static long xgetver(void)
 }
 
 
+/*
+ *  xsstat - Function 0x58 (Sstat) - EmuTOS extension
+ *
+ *  copies up to 'len' bytes of the statistics for the subsystem specified
+ *  by 'which' to 'buf', and returns the number of bytes copied.  if the
+ *  SS_RESET flag is set in 'which', the counters are then cleared.  the
+ *  SS_FLUSH flag empties the program image cache, or writes out the BIOS
+ *  write queue, before the statistics are copied; if the queue cannot be
+ *  written out, the error is returned instead.
+ */
+static long xsstat(int which, void *buf, long len)
+{
+    UBYTE *stats;
+    long size, counters;
+#if CONF_WITH_RWQUEUE
+    long err;
+#endif
+
+    switch(which & ~(SS_RESET|SS_FLUSH)) {
+#if CONF_WITH_BDOS_CACHE
+    case SS_BUFCACHE:
+        stats = (UBYTE *)&bcstat;
+        size = sizeof(BCSTAT);
+        counters = offsetof(BCSTAT, bc_hits);
+        break;
+#endif
+#if CONF_WITH_PEXEC_CACHE
+    case SS_PEXECCACHE:
+        if (which & SS_FLUSH)
+            pxcache_purge(-1);
+        stats = (UBYTE *)&pxstat;
+        size = sizeof(PXSTAT);
+        counters = offsetof(PXSTAT, px_hits);
+        break;
+#endif
+    case SS_PGMLOAD:
+        stats = (UBYTE *)&plstat;
+        size = sizeof(PLSTAT);
+        counters = 0;
+        break;
+    case SS_OSMEM:
+        stats = (UBYTE *)&osmstat;
+        size = sizeof(OSMSTAT);
+        counters = offsetof(OSMSTAT, os_scavenges);
+        break;
+#if CONF_WITH_RWQUEUE
+    case SS_RWQUEUE:
+        if (which & SS_FLUSH)
+        {
+            err = rwq_flush(-1);
+            if (err < 0L)
+                return err;
+        }
+        stats = (UBYTE *)&rqstat;
+        size = sizeof(RQSTAT);
+        counters = offsetof(RQSTAT, rq_requests);
+        break;
+#endif
+#if CONF_WITH_BESTFIT
+    case SS_MEMORY:
+        stats = (UBYTE *)xmstat();
+        size = sizeof(MEMSTAT);
+        counters = offsetof(MEMSTAT, ms_allocs);
+        break;
+#endif
+    default:
+        return EINVFN;
+    }
+
+    if (len > size)
+        len = size;
+    if (len > 0)
+        memcpy(buf, stats, len);
+
+    if (which & SS_RESET)
+        bzero(stats+counters, size-counters);
+
+    return len < 0 ? 0L : len;
+}
+
+
 /*
  *  ni -
  */
@@ -340,6 +444,10 @@ void osinit_after_xmaddalt(void)
 
     time_init();
 
+#if CONF_WITH_BDOS_CACHE && CONF_WITH_STATIC_ALT_RAM
+    bufl_init_altram();     /* add buffers in Alt-RAM */
+#endif
+
     KDEBUG(("BDOS: address of basepage = %p\n", run));
 
     stdhdl_init();  /* set up system initial standard handles */
@@ -348,6 +456,19 @@ void osinit_after_xmaddalt(void)
 }
 
 
+/*
+ *  osflush - write all dirty buffers to disk
+ *
+ *  this is called by the BIOS outside of any GEMDOS call (before
+ *  shutdown), so we must provide our own error recovery point
+ */
+void osflush(void)
+{
+    if (setjmp(errbuf) == 0)
+        bufl_flush(-1);
+}
+
+
 /*
  *  freetree -  free the directory node tree
  */
@@ -393,6 +514,10 @@ static void offree(DMD *d)
         {
             if (f->o_dmd == d)
             {
+#if CONF_WITH_EXTENT_MAP
+                if (f->o_dfd == &f->o_disk)
+                    xmap_free(f->o_dfd);
+#endif
                 xmfreblk(f);
                 sft[i].f_ofd = NULL;
                 sft[i].f_own = NULL;
@@ -457,6 +582,16 @@ restrt:
             dmd = drvtbl[errdrv];
             dn = dmd->m_dtl;
             offree(dmd);
+#if CONF_WITH_DIR_CACHE
+            dcache_purge(dmd);
+#endif
+#if CONF_WITH_PEXEC_CACHE
+            pxcache_purge(errdrv);
+#endif
+#if CONF_WITH_FAT_MAP
+            if (dmd->m_fmap)
+                xmfreblk(dmd->m_fmap);
+#endif
             xmfreblk(dmd);
             drvtbl[errdrv] = NULL;
 
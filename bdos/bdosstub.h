@@ -25,6 +25,19 @@ long xmaddalt(UBYTE *start, long size);
 long total_alt_ram(void);
 #endif /* CONF_WITH_ALT_RAM */
 
+/* Write dirty BDOS buffers to disk: for the specified drive,
+ * or all drives if -1 */
+void bufl_flush(WORD drv);
+
+/* Write all dirty BDOS buffers to disk, e.g. before shutdown */
+void osflush(void);
+
+#if CONF_WITH_LAZY_WRITEBACK
+/* Background write-back of old dirty BDOS buffers, called from the VBL
+ * interrupt via blkdev_vblflush(), when the BDOS is not active */
+void bufl_lazyflush(void);
+#endif
+
 /* BDOS quick pool.
  * Declared here because referenced by the BIOS OSHEADER */
 #define MAXQUICK 5
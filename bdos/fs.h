@@ -55,8 +55,11 @@ extern  long    rwerr;
 extern  jmp_buf errbuf;
 extern  int     errdrv;
 extern  long    errcode;
+extern  ULONG   rwabs_calls;
 
 #define longjmp_rwabs(flg,buf,cnt,rec,dev)            \
+do {                                                  \
+    rwabs_calls++;                                    \
     if (rec <= 32767)                                 \
     {                                                 \
         /* kprintf("\nRwabs short, rec = %i\n", (int)(rec)); */ \
@@ -75,6 +78,7 @@ extern  long    errcode;
              longjmp(errbuf,1);                       \
         }                                             \
     }                                                 \
+} while (0)
 
 /*
  *  Type declarations
@@ -83,9 +87,15 @@ extern  long    errcode;
 typedef struct _ofd OFD;
 typedef struct _dnd DND;
 typedef struct _dmd DMD;
+typedef struct _fatmap FATMAP;
+typedef struct _xmap XMAP;
 
 typedef UWORD FH;               /*  file handle    */
+#if CONF_WITH_FAT32
+typedef ULONG CLNO;             /*  cluster number */
+#else
 typedef UWORD CLNO;             /*  cluster number */
+#endif
 typedef ULONG RECNO;            /*  record number  */
 
 
@@ -115,10 +125,12 @@ typedef struct
 {
     UWORD o_flag;       /* see below                            */
     WORD  o_usecnt;     /* count of open OFDs pointing here     */
-                    /* the following 3 items must be as in FCB: */
     DOSTIME o_td;       /* creation time/date: little-endian!   */
     CLNO  o_strtcl;     /* starting cluster number              */
     long  o_fileln;     /* length of file in bytes              */
+#if CONF_WITH_EXTENT_MAP
+    XMAP  *o_xmap;      /* extent map, or NULL                  */
+#endif
 } DFD;
 
 
@@ -126,6 +138,29 @@ typedef struct
  * bit usage in o_flag 
  */
 #define O_DIRTY     1   /* contents have changed, FCB on disk must be updated */ 
+#define O_PREALLOC  2   /* cluster chain may extend beyond end of file */
+
+
+#if CONF_WITH_EXTENT_MAP
+/*
+ *  XMAP - extent map for an open file (see fsio.c)
+ *
+ *  extent i is a run of contiguous clusters: it starts at cluster
+ *  x_fcl[i] within the file (counting from 0), which is cluster
+ *  x_dcl[i] on disk, and ends just before x_fcl[i+1].  the map
+ *  always describes the start of the cluster chain: x_fcl[x_count]
+ *  is the number of clusters mapped so far.
+ *
+ *  note: this is allocated via MGET(), so it must fit in 64 bytes
+ */
+#define XMAP_EXTENTS    ((64-sizeof(WORD)-sizeof(CLNO))/(2*sizeof(CLNO)))
+struct _xmap
+{
+    WORD  x_count;                  /* number of extents in use     */
+    CLNO  x_fcl[XMAP_EXTENTS+1];    /* first cluster within file    */
+    CLNO  x_dcl[XMAP_EXTENTS];      /* first cluster on disk        */
+} ;
+#endif
 
 
 /*
@@ -180,9 +215,10 @@ typedef struct
 {
     char f_name[FNAMELEN];
     UBYTE f_attrib;
-    UBYTE f_fill[10];
+    UBYTE f_fill[8];
+    UWORD f_clusthi;        /* high word of cluster (FAT32 only) */
     DOSTIME f_td;           /* time, date */
-    CLNO f_clust;
+    UWORD f_clust;          /* low word of cluster */
     long f_fileln;
 } FCB;
 
@@ -217,6 +253,8 @@ struct _dnd         /* directory node descriptor */
 
     long d_scan;        /*  current posn in dir for DND tree    */
     OFD  *d_files;      /* open files on this node              */
+    long d_free;        /*  posn of 1st dir entry that may be   */
+                        /*  free: all before it are in use      */
 } ;
 
 /*
@@ -235,7 +273,11 @@ struct _dmd         /* drive media block */
 {
     RECNO  m_recoff[3]; /*  record offsets for fat,dir,data     */
     WORD   m_drvnum;    /*  drive number for this media         */
+#if CONF_WITH_FAT32
+    LONG   m_fsiz;      /*  fat size in records                 */
+#else
     WORD   m_fsiz;      /*  fat size in records M01.01.03       */
+#endif
     WORD   m_clsiz;     /*  cluster size in records M01.01.03   */
     UWORD  m_clsizb;    /*  cluster size in bytes               */
     UWORD  m_recsiz;    /*  record size in bytes                */
@@ -253,9 +295,44 @@ struct _dmd         /* drive media block */
     DND    *m_dtl;      /* root of directory tree list          */
     UBYTE  m_16;        /* 16 bit fat ?                         */
     UBYTE  m_1fat;      /* 1 FAT only ?                         */
+#if CONF_WITH_FAT_MAP
+    FATMAP *m_fmap;     /* allocation map, or NULL              */
+#endif
+#if CONF_WITH_FAT32
+    UBYTE  m_32;        /* 32 bit fat ?                         */
+    UBYTE  m_fsidirty;  /* FSInfo sector needs updating ?       */
+    UWORD  m_fsinfo;    /* FSInfo record number, or 0           */
+#endif
 } ;
 
 
+#if CONF_WITH_FAT_MAP
+/*
+ *  FATMAP - allocation map for a drive (see fsfat.c)
+ *
+ *  each bit of fm_full corresponds to a group of 2**fm_shift FAT
+ *  records, and is set when the group is known to contain no free
+ *  clusters.  the map is built lazily by findfree(), and bits are
+ *  cleared by clfix() when a cluster is freed.
+ *
+ *  fm_nfree is the number of free clusters, counted by the first
+ *  Dfree() and then maintained by clfix().
+ *
+ *  note: this is allocated via MGET(), so it must fit in 64 bytes
+ */
+#define FATMAP_BYTES    48
+#define FATMAP_BITS     (FATMAP_BYTES*8)
+struct _fatmap
+{
+    CLNO   fm_next;     /* next-fit cursor for new chains       */
+    WORD   fm_shift;    /* log (base 2) of FAT records per bit  */
+    CLNO   fm_nfree;    /* number of free clusters ...          */
+    UBYTE  fm_nfreeok;  /* ... if this is TRUE                  */
+    UBYTE  fm_full[FATMAP_BYTES];
+} ;
+#endif
+
+
 /*
  *  buffer type values
  */
@@ -316,9 +393,11 @@ typedef struct
                                 /*   bits 4-0: drive id                 */
                                 /*   bits 31-5: if root, offset to next */
                                 /*    FCB, otherwise 0                  */
+                                /*   bits 31-16: if subdir on FAT32,    */
+                                /*    high word of dt_clnum             */
     UWORD dt_cloffset;          /*  if subdir, offset within cluster to */
                                 /*   next FCB, otherwise 0              */
-    CLNO  dt_clnum;             /*  if subdir, current cluster number,  */
+    UWORD dt_clnum;             /*  if subdir, current cluster number,  */
                                 /*   otherwise 0                        */
     char  dt_attr;              /*  attribute from Fsfirst()            */
                             /* public area, must not change             */
@@ -398,6 +477,18 @@ BOOL contains_illegal_characters(const char *test);
  */
 
 void bufl_init(void);
+#if CONF_WITH_BDOS_CACHE
+#if CONF_WITH_STATIC_ALT_RAM
+void bufl_init_altram(void);
+#endif
+extern BCSTAT bcstat;
+#endif
+#if CONF_WITH_READAHEAD
+/* read data records into the cache ahead of time */
+void bufl_readahead(DMD *dm, RECNO recnum, WORD n);
+/* copy data records from the cache, returns number copied */
+WORD bufl_read(DMD *dm, RECNO recnum, WORD n, UBYTE *ubuf);
+#endif
 /* ??? */
 void flush(BCB *b);
 /* return the ptr to the buffer containing the desired record */
@@ -410,10 +501,20 @@ BCB *getbcb(DMD *dmd,WORD buftype,RECNO recnum);
 
 RECNO cl2rec(CLNO cl, DMD *dm);
 void clfix(CLNO cl, CLNO link, DMD *dm);
+void freechain(CLNO cl, DMD *dm);
 CLNO getrealcl(CLNO cl, DMD *dm);
 CLNO getclnum(CLNO cl, OFD *of);
+CLNO getfcbcl(const FCB *f, const DMD *dm);
+void setfcbcl(FCB *f, CLNO cl, const DMD *dm);
 int nextcl(OFD *p, int wrtflg);
+#if CONF_WITH_PREALLOC
+void prealloc(OFD *p, long len);
+void trimchain(OFD *p);
+#endif
 long xgetfree(long *buf, int drv);
+#if CONF_WITH_FAT32
+void fsinfo_update(DMD *dm);
+#endif
 
 /*
  * in fsio.c
@@ -426,6 +527,11 @@ long eof(int h);
 long xlseek(long n, int h, int flg);
 long ixlseek(OFD *p, long n);
 
+#if CONF_WITH_EXTENT_MAP
+/* discard the extent map for a file */
+void xmap_free(DFD *dfd);
+#endif
+
 FCB *ixgetfcb(OFD *p);
 
 long xread(int h, long len, void *ubufr);
@@ -444,6 +550,12 @@ long xchmod(char *p, int wrt, UBYTE mod);
 long ixsfirst(char *name, WORD att, DTAINFO *addr);
 long xsfirst(char *name, int att);
 long xsnext(void);
+#if CONF_WITH_FSLIST
+long xslist(char *name, int att, FSLIST *buf, long len);
+#endif
+#if CONF_WITH_FCOPY
+long xfcopy(int src, int dst, long len);
+#endif
 long xgsdtof(DOSTIME *buf, int h, int wrt);
 void builds(const char *s1 , char *s2 );
 long xrename(int n, char *p1, char *p2);
@@ -456,6 +568,10 @@ int incr_curdir_usage(DND *dnd);
 void decr_curdir_usage(int index);
 OFD *makofd(DND *p);
 WORD free_available_dnds(void);
+#if CONF_WITH_DIR_CACHE
+void dcache_drop(DND *dn, const char *name);
+void dcache_purge(DMD *dm);
+#endif
 
 
 /*
@@ -472,8 +588,13 @@ OFD  *getofd(int h);
  * FAT chain defines
  */
 #define FREECLUSTER     0x0000
+#if CONF_WITH_FAT32
+#define ENDOFCHAIN      0x0fffffffL                     /* our end-of-chain marker */
+#define endofchain(a)   (((a)&0x0ffffff8L)==0x0ffffff8L)/* in case file was created by someone else */
+#else
 #define ENDOFCHAIN      0xffff                  /* our end-of-chain marker */
 #define endofchain(a)   (((a)&0xfff8)==0xfff8)  /* in case file was created by someone else */
+#endif
 
 
 /* Misc. defines */
@@ -481,4 +602,6 @@ OFD  *getofd(int h);
 #define CL_DIR  0x0002      /* this is a directory file, flush, do not free */
 #define CL_FULL 0x0004      /* even though it's a directory, full close */
 
+#define DIR_FILE_LENGTH 0x7fffffffL     /* fake size for directories */
+
 #endif /* FS_H */
@@ -20,9 +20,196 @@
 #include "string.h"
 #include "tosvars.h"
 #include "biosext.h"
+#include "has.h"        /* for has_alt_ram */
+#include "bdosstub.h"
 
 #define NUMBUFS 2       /* buffers per list */
 
+#if CONF_WITH_BDOS_CACHE
+
+/*
+ * The BCB lists at bufl[] are part of the TOS API: other programs may
+ * walk them, or add their own BCBs to them.  So we keep them, but each
+ * of our own BCBs is embedded in a CBCB, which adds a link for the hash
+ * chain, plus a 'timestamp' for LRU replacement.  Foreign BCBs can only
+ * be found by walking the lists, which is done on a hash miss.
+ *
+ * Note that the BCB fields may be changed behind our back (for example
+ * by usrio() or mark_bcbs_invalid()), so the hash table is only a hint:
+ * the contents of a BCB found via the hash are always checked.
+ */
+typedef struct _cbcb CBCB;
+struct _cbcb
+{
+    BCB     c_bcb;      /*  must be first               */
+    CBCB    *c_hlink;   /*  next CBCB on hash chain     */
+    ULONG   c_lastuse;  /*  bcb_clock value at last use */
+    WORD    c_hash;     /*  hash chain index, or -1     */
+#if CONF_WITH_READAHEAD
+    BOOL    c_ahead;    /*  read ahead & not used yet   */
+#endif
+#if CONF_WITH_LAZY_WRITEBACK
+    LONG    c_dirtytime;/*  hz_200 value when dirtied   */
+    BOOL    c_lazy;     /*  written back in background  */
+#endif
+};
+
+#define HASHSIZE        64      /* must be a power of 2 */
+#define BCBHASH(drv,typ,rec)    (((rec) + ((drv) << 4) + (typ)) & (HASHSIZE-1))
+
+/*
+ * the number of buffers per list may be set via this NVRAM byte: if
+ * bit 7 is set, bits 0-6 contain the number (limited to NUMBUFS-MAXBUFS)
+ */
+#define NVRAM_BUFFERS   17
+#define MAXBUFS         64
+
+/*
+ * within the dir/data list, neither root dir nor data buffers may use
+ * more than this number of buffers, when they need a new one
+ */
+#define QUOTA(n)        ((n) - (n)/4)
+
+/*
+ * dirty buffers for consecutive records are written with a single
+ * Rwabs() via this staging buffer (if the record size allows).  dirty
+ * FAT records are written back after FATDELAY ticks.  this is checked
+ * by getrec(), so it only happens while the file system is in use; with
+ * CONF_WITH_LAZY_WRITEBACK, the background write-back also applies it to
+ * our own FAT buffers on hard disks when the system is idle.
+ */
+#define FLUSHBUF_SIZE   4096L
+#define MAXRUN          8       /* max records per write */
+#define FATDELAY        (2*CLOCKS_PER_SEC)
+
+#if CONF_WITH_LAZY_WRITEBACK
+/*
+ * dirty buffers are written back in the background when they are older
+ * than LAZYAGE ticks.  the buffer lists are examined at most once every
+ * LAZYCHECK ticks, and only one run of records is written each time, to
+ * limit the time spent in the VBL interrupt.  floppies are left alone:
+ * they are slow, and the user may eject the disk at any time.
+ */
+#define LAZYAGE         ((LONG)CONF_WRITEBACK_AGE * CLOCKS_PER_SEC / 1000)
+#define LAZYFATAGE      ((LAZYAGE < FATDELAY) ? LAZYAGE : FATDELAY)
+#define LAZYCHECK       (CLOCKS_PER_SEC/10)
+#define FIRSTLAZYDRV    2       /* drives A: & B: are floppies */
+#endif
+
+BCSTAT bcstat;
+
+static CBCB *bcbhash[HASHSIZE];
+static ULONG bcb_clock;
+
+static UBYTE *flushbuf;     /* staging buffer, or NULL */
+static BOOL fat_dirty;      /* TRUE iff a FAT record may be dirty */
+static LONG fat_dirty_time; /* hz_200 value when it was dirtied */
+
+#if CONF_WITH_LAZY_WRITEBACK
+static BOOL lazy_dirty;     /* TRUE iff one of our BCBs may be dirty */
+static LONG lazy_check_time;/* hz_200 value at last check */
+#endif
+
+/* memory areas containing our CBCBs (in ST-RAM & Alt-RAM) */
+static UBYTE *cbcb_start[2], *cbcb_end[2];
+
+#if CONF_WITH_STATIC_ALT_RAM
+static WORD numaltbufs;     /* buffers per list to put in Alt-RAM */
+#endif
+
+/*
+ * get the number of buffers per list
+ */
+static WORD get_numbufs(void)
+{
+    WORD numbufs = CONF_BDOS_BUFFERS;
+#if CONF_WITH_NVRAM
+    UBYTE temp;
+
+    if (nvmaccess(0, NVRAM_BUFFERS, 1, &temp) == 0)
+        if (temp & 0x80)
+            numbufs = temp & 0x7f;
+#endif
+
+    if (numbufs < NUMBUFS)
+        numbufs = NUMBUFS;
+    else if (numbufs > MAXBUFS)
+        numbufs = MAXBUFS;
+
+    return numbufs;
+}
+
+/* return TRUE iff the BCB is one of ours */
+static BOOL is_cbcb(BCB *b)
+{
+    int i;
+
+    for (i = 0; i < 2; i++)
+        if (((UBYTE *)b >= cbcb_start[i]) && ((UBYTE *)b < cbcb_end[i]))
+            return TRUE;
+
+    return FALSE;
+}
+
+/* remove a CBCB from its hash chain (if any) */
+static void unhash(CBCB *c)
+{
+    CBCB **q;
+
+    if (c->c_hash < 0)
+        return;
+
+    for (q = &bcbhash[c->c_hash]; *q; q = &(*q)->c_hlink)
+    {
+        if (*q == c)
+        {
+            *q = c->c_hlink;
+            break;
+        }
+    }
+    c->c_hash = -1;
+}
+
+/* look up a record in the hash table */
+static CBCB *hashfind(WORD drv, WORD buftype, RECNO recnum)
+{
+    CBCB *c;
+    BCB *b;
+
+    for (c = bcbhash[BCBHASH(drv,buftype,recnum)]; c; c = c->c_hlink)
+    {
+        b = &c->c_bcb;
+        if ((b->b_bufdrv == drv) && (b->b_buftyp == buftype) && (b->b_bufrec == recnum))
+            break;
+    }
+
+    return c;
+}
+
+/*
+ * creates a chain of CBCBs and corresponding buffers, and adds it to
+ * the front of the specified list.  returns ptr to the end of the area.
+ */
+static UBYTE *create_chain(BCB **phdr,UBYTE *p,LONG n,WORD count)
+{
+    CBCB *c;
+    WORD i;
+
+    for (i = 0; i < count; i++, p += n) {
+        c = (CBCB *)p;
+        bzero(c,sizeof(CBCB));
+        c->c_bcb.b_link = *phdr;            /* chain to list */
+        c->c_bcb.b_bufdrv = -1;             /* mark as invalid */
+        c->c_bcb.b_bufr = p + sizeof(CBCB);
+        c->c_hash = -1;
+        *phdr = &c->c_bcb;
+    }
+
+    return p;
+}
+
+#else
+
 /* creates a chain of BCBs and corresponding buffers */
 static void *create_chain(UBYTE *p,LONG n)
 {
@@ -41,6 +228,8 @@ static void *create_chain(UBYTE *p,LONG n)
     return p;
 }
 
+#endif /* CONF_WITH_BDOS_CACHE */
+
 /*
  * bufl_init - BDOS buffer list initialization
  *
@@ -51,6 +240,79 @@ static void *create_chain(UBYTE *p,LONG n)
  * therefore assume that all memory from membot upwards is available
  * (I'm looking at you, Dungeon Master).
  */
+#if CONF_WITH_BDOS_CACHE
+void bufl_init(void)
+{
+    UBYTE *p;
+    LONG n, size;
+    WORD numbufs;
+
+    numbufs = get_numbufs();
+#if CONF_WITH_STATIC_ALT_RAM
+    /* Alt-RAM will be available: only allocate the minimum here */
+    numaltbufs = numbufs - NUMBUFS;
+    numbufs = NUMBUFS;
+#endif
+
+    n = sizeof(CBCB) + pun_ptr->max_sect_siz;
+    size = 2L * numbufs * n;
+    p = balloc_stram(size, FALSE);
+    if (!p)
+        panic("bufl_init(%ld): no memory\n",size);
+    cbcb_start[0] = p;
+    cbcb_end[0] = p + size;
+
+    bufl[BI_FAT] = bufl[BI_DATA] = NULL;
+    p = create_chain(&bufl[BI_FAT],p,n,numbufs);
+    create_chain(&bufl[BI_DATA],p,n,numbufs);
+
+    bcstat.bc_nfat = bcstat.bc_ndata = numbufs;
+
+    /* the staging buffer is optional: without it, we write singly */
+    if (2L*pun_ptr->max_sect_siz <= FLUSHBUF_SIZE)
+        flushbuf = balloc_stram(FLUSHBUF_SIZE, FALSE);
+}
+
+#if CONF_WITH_STATIC_ALT_RAM
+/*
+ * bufl_init_altram - add the remaining buffers, allocated in Alt-RAM
+ *
+ * this must be called after Alt-RAM has been added to the memory pool.
+ * if there is not enough Alt-RAM, we just run with the minimum.
+ */
+void bufl_init_altram(void)
+{
+    MD *m;
+    UBYTE *p;
+    LONG n, size;
+
+    if (!has_alt_ram || (numaltbufs <= 0))
+        return;
+
+    n = sizeof(CBCB) + pun_ptr->max_sect_siz;
+    size = 2L * numaltbufs * n;
+    m = ffit(size, &pmdalt);
+    if (!m)
+    {
+        KDEBUG(("bufl_init_altram(%ld): no memory\n",size));
+        return;
+    }
+    ownit(m, NULL);     /* belongs to the system */
+
+    p = m->m_start;
+    cbcb_start[1] = p;
+    cbcb_end[1] = p + size;
+
+    p = create_chain(&bufl[BI_FAT],p,n,numaltbufs);
+    create_chain(&bufl[BI_DATA],p,n,numaltbufs);
+
+    bcstat.bc_nfat += numaltbufs;
+    bcstat.bc_ndata += numaltbufs;
+}
+#endif
+
+#else
+
 void bufl_init(void)
 {
     UBYTE *p;
@@ -70,6 +332,8 @@ void bufl_init(void)
     create_chain(p,n);
 }
 
+#endif /* CONF_WITH_BDOS_CACHE */
+
 
 /*
  * flush -
@@ -90,23 +354,506 @@ void flush(BCB *b)
     b->b_bufdrv = -1;           /* invalidate in case of error */
 
     longjmp_rwabs(1, (long)b->b_bufr, 1, b->b_bufrec+dm->m_recoff[n], d);
+#if CONF_WITH_BDOS_CACHE
+    bcstat.bc_writes++;
+    bcstat.bc_wrecs++;
+#endif
 
     /* flush to both fats */
 
     if (n == BT_FAT && !dm->m_1fat) {
         longjmp_rwabs(1, (long)b->b_bufr, 1,
                       b->b_bufrec+dm->m_recoff[BT_FAT]-dm->m_fsiz, d);
+#if CONF_WITH_BDOS_CACHE
+        bcstat.bc_writes++;
+        bcstat.bc_wrecs++;
+#endif
     }
     b->b_bufdrv = d;                    /* re-validate */
     b->b_dirty = 0;
 }
 
 
+#if CONF_WITH_RWQUEUE
+/*
+ * flush_rwq - write out the BIOS write queue
+ *
+ * the BIOS has already called the critical error handler, and dropped
+ * the sectors that could not be written: like longjmp_rwabs(), we just
+ * pass the error on to the caller of the GEMDOS function
+ */
+static void flush_rwq(void)
+{
+    rwerr = rwq_flush(-1);
+    if (rwerr < 0L)
+    {
+        errdrv = rwq_errdev;
+        errcode = rwerr;
+        if ((errcode == E_CHNG) && !drvtbl[errdrv])
+            errcode = EWRITF;   /* not one of our drives, nothing to relog */
+        longjmp(errbuf,1);
+    }
+}
+#endif
+
+
+#if CONF_WITH_BDOS_CACHE
+/*
+ * write_run - write the buffers for 'n' consecutive records with
+ * a single Rwabs() (per FAT copy), via the staging buffer
+ *
+ * see flush() for error handling
+ */
+static void write_run(BCB **rbcb, WORD n)
+{
+    BCB *b = rbcb[0];
+    DMD *dm = b->b_dm;
+    UBYTE *p;
+    int i, t, d;
+
+    t = b->b_buftyp;
+    d = b->b_bufdrv;
+
+    for (i = 0, p = flushbuf; i < n; i++, p += dm->m_recsiz)
+    {
+        memcpy(p, rbcb[i]->b_bufr, dm->m_recsiz);
+        rbcb[i]->b_bufdrv = -1;         /* invalidate in case of error */
+    }
+
+    longjmp_rwabs(1, (long)flushbuf, n, b->b_bufrec+dm->m_recoff[t], d);
+    bcstat.bc_writes++;
+    bcstat.bc_wrecs += n;
+
+    /* flush to both fats */
+
+    if (t == BT_FAT && !dm->m_1fat) {
+        longjmp_rwabs(1, (long)flushbuf, n,
+                      b->b_bufrec+dm->m_recoff[BT_FAT]-dm->m_fsiz, d);
+        bcstat.bc_writes++;
+        bcstat.bc_wrecs += n;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        rbcb[i]->b_bufdrv = d;          /* re-validate */
+        rbcb[i]->b_dirty = 0;
+    }
+}
+
+
+/*
+ * flush_list - flush the dirty buffers in a list for the specified
+ * drive (-1 => all drives), in ascending record order, coalescing
+ * consecutive records of the same type
+ */
+static void flush_list(BCB *list, WORD drv)
+{
+    BCB *b, *first;
+    BCB *rbcb[MAXRUN];
+    WORD n, maxrun;
+
+    for (;;)
+    {
+        /*
+         * find the lowest dirty record, for the same drive & type as
+         * the first dirty buffer in the list
+         */
+        first = NULL;
+        for (b = list; b; b = b->b_link)
+        {
+            if ((b->b_bufdrv == -1) || !b->b_dirty)
+                continue;
+            if ((drv >= 0) && (b->b_bufdrv != drv))
+                continue;
+            if (!first)
+                first = b;
+            else if ((b->b_bufdrv == first->b_bufdrv)
+                  && (b->b_buftyp == first->b_buftyp)
+                  && (b->b_bufrec < first->b_bufrec))
+                first = b;
+        }
+        if (!first)
+            break;
+
+        maxrun = 1;
+        if (flushbuf)
+        {
+            maxrun = FLUSHBUF_SIZE / first->b_dm->m_recsiz;
+            if (maxrun > MAXRUN)
+                maxrun = MAXRUN;
+        }
+
+        /* now collect the dirty buffers for the following records */
+        rbcb[0] = first;
+        for (n = 1; n < maxrun; n++)
+        {
+            for (b = list; b; b = b->b_link)
+                if ((b->b_bufdrv == first->b_bufdrv) && b->b_dirty
+                 && (b->b_buftyp == first->b_buftyp)
+                 && (b->b_bufrec == first->b_bufrec+n))
+                    break;
+            if (!b)
+                break;
+            rbcb[n] = b;
+        }
+
+        if (n == 1)
+            flush(first);
+        else
+            write_run(rbcb, n);
+    }
+}
+
+
+/*
+ * bufl_flush - write all dirty buffers for the specified drive
+ * (-1 => all drives) to disk
+ */
+void bufl_flush(WORD drv)
+{
+    flush_list(bufl[BI_FAT], drv);
+    if (drv < 0)
+        fat_dirty = FALSE;
+    flush_list(bufl[BI_DATA], drv);
+#if CONF_WITH_RWQUEUE
+    flush_rwq();        /* the BIOS may still hold the sectors back */
+#endif
+}
+
+
+#if CONF_WITH_LAZY_WRITEBACK
+/*
+ * lazy_rwabs - write records for bufl_lazyflush(): unlike
+ * longjmp_rwabs(), this just returns the error code.  we are in the
+ * VBL interrupt, so the BIOS must not call the critical error handler.
+ */
+static LONG lazy_rwabs(UBYTE *buf, WORD n, LONG rec, WORD drv)
+{
+    if (rec <= 32767)
+        return Rwabs(1|RW_NOCRITIC, (long)buf, n, rec, drv, 0);
+
+    return Rwabs(1|RW_NOCRITIC, (long)buf, n, -1, drv, rec);
+}
+
+
+/*
+ * lazy_list - find the lowest dirty record in a list that is old enough
+ * to be written back in the background, and write it together with the
+ * dirty records that follow it.  only our own BCBs are considered.
+ *
+ * returns TRUE if something was written (or tried), and sets *pending
+ * if there are any dirty buffers that have not been written.
+ */
+static BOOL lazy_list(BCB *list, BOOL *pending)
+{
+    BCB *b, *first;
+    BCB *rbcb[MAXRUN];
+    CBCB *c;
+    DMD *dm;
+    UBYTE *p;
+    LONG err, age;
+    WORD i, n, t, d, maxrun;
+
+    first = NULL;
+    for (b = list; b; b = b->b_link)
+    {
+        if ((b->b_bufdrv == -1) || !b->b_dirty || !is_cbcb(b))
+            continue;
+        *pending = TRUE;
+        age = (b->b_buftyp == BT_FAT) ? LAZYFATAGE : LAZYAGE;
+        if ((b->b_bufdrv < FIRSTLAZYDRV)
+         || (hz_200 - ((CBCB *)b)->c_dirtytime <= age))
+            continue;
+        if (!first)
+            first = b;
+        else if ((b->b_bufdrv == first->b_bufdrv)
+              && (b->b_buftyp == first->b_buftyp)
+              && (b->b_bufrec < first->b_bufrec))
+            first = b;
+    }
+    if (!first)
+        return FALSE;
+
+    dm = first->b_dm;
+    t = first->b_buftyp;
+    d = first->b_bufdrv;
+
+    maxrun = 1;
+    if (flushbuf)
+    {
+        maxrun = FLUSHBUF_SIZE / dm->m_recsiz;
+        if (maxrun > MAXRUN)
+            maxrun = MAXRUN;
+    }
+
+    /* collect our dirty buffers for the following records */
+    rbcb[0] = first;
+    for (n = 1; n < maxrun; n++)
+    {
+        for (b = list; b; b = b->b_link)
+            if ((b->b_bufdrv == d) && b->b_dirty && (b->b_buftyp == t)
+             && (b->b_bufrec == first->b_bufrec+n) && is_cbcb(b))
+                break;
+        if (!b)
+            break;
+        rbcb[n] = b;
+    }
+
+    if (n == 1)
+        p = first->b_bufr;
+    else
+    {
+        p = flushbuf;
+        for (i = 0; i < n; i++)
+            memcpy(p+i*dm->m_recsiz, rbcb[i]->b_bufr, dm->m_recsiz);
+    }
+
+    err = lazy_rwabs(p, n, first->b_bufrec+dm->m_recoff[t], d);
+    if (!err)
+    {
+        bcstat.bc_lazywrites++;
+        bcstat.bc_lazyrecs += n;
+
+        /* flush to both fats */
+
+        if (t == BT_FAT && !dm->m_1fat) {
+            err = lazy_rwabs(p, n, first->b_bufrec+dm->m_recoff[BT_FAT]-dm->m_fsiz, d);
+            if (!err)
+            {
+                bcstat.bc_lazywrites++;
+                bcstat.bc_lazyrecs += n;
+            }
+        }
+    }
+
+    /*
+     * on error, the buffers stay dirty, and we don't try again before
+     * they are old enough: a synchronous flush will report the error.
+     * this includes E_CHNG: Rwabs() never writes to media that may have
+     * been changed, and the next access by the BDOS will find out.
+     */
+    for (i = 0; i < n; i++)
+    {
+        c = (CBCB *)rbcb[i];
+        if (err)
+            c->c_dirtytime = hz_200;
+        else
+        {
+            c->c_bcb.b_dirty = 0;
+            c->c_lazy = TRUE;
+        }
+    }
+
+    return TRUE;
+}
+
+
+/*
+ * bufl_lazyflush - write back old dirty buffers in the background
+ *
+ * this is called from the VBL interrupt by blkdev_vblflush(), only
+ * when neither the BDOS nor the BIOS is active, so the buffer lists
+ * are consistent and Rwabs() may be called.
+ */
+void bufl_lazyflush(void)
+{
+    BOOL pending;
+
+    if (!lazy_dirty)
+        return;
+    if (hz_200 - lazy_check_time < LAZYCHECK)
+        return;
+    lazy_check_time = hz_200;
+
+    pending = FALSE;
+    if (lazy_list(bufl[BI_FAT], &pending))
+        return;
+    if (lazy_list(bufl[BI_DATA], &pending))
+        return;
+    if (!pending)
+        lazy_dirty = FALSE;
+}
+#endif /* CONF_WITH_LAZY_WRITEBACK */
+#else
+void bufl_flush(WORD drv)
+{
+    BCB *b;
+    int i;
+
+    for (i = BI_FAT; i <= BI_DATA; i++)
+        for (b = bufl[i]; b; b = b->b_link)
+            if ((b->b_bufdrv != -1) && b->b_dirty && ((drv < 0) || (b->b_bufdrv == drv)))
+                flush(b);
+#if CONF_WITH_RWQUEUE
+    flush_rwq();        /* the BIOS may still hold the sectors back */
+#endif
+}
+#endif /* CONF_WITH_BDOS_CACHE */
+
+
 /*
  * getbcb - called by getrec() to get the BCB for the desired record
  *
  * buftype is BT_FAT, BT_ROOT, or BT_DATA
  */
+#if CONF_WITH_BDOS_CACHE
+BCB *getbcb(DMD *dmd,WORD buftype,RECNO recnum)
+{
+    BCB *b, *mtbuf, *lru, *lrutyp, **phdr;
+    CBCB *c;
+    ULONG stamp, oldest, oldtyp;
+    WORD drv, h, total, ntyp;
+    int err;
+
+    drv = dmd->m_drvnum;
+    h = BCBHASH(drv,buftype,recnum);
+    phdr = &bufl[buftype==BT_FAT ? BI_FAT : BI_DATA];
+
+    /*
+     * first look in the hash table
+     */
+    c = hashfind(drv,buftype,recnum);
+    if (c)
+    {
+        b = &c->c_bcb;
+        goto found;
+    }
+
+    /*
+     * not there: walk the list, because the desired record may be in
+     * a foreign BCB.  meanwhile, remember the first invalid (available)
+     * buffer, plus the least recently used buffer, both overall and of
+     * the desired type.  foreign buffers have no timestamp, so we treat
+     * them as older than any of ours.
+     */
+    mtbuf = lru = lrutyp = NULL;
+    oldest = oldtyp = 0UL;
+    total = ntyp = 0;
+
+    for (b = *phdr; b; b = b->b_link)
+    {
+        if (b->b_bufdrv == -1)  /*  if buffer not valid */
+        {
+            if (!mtbuf)
+                mtbuf = b;      /*    then it's 'empty' */
+            continue;
+        }
+        if ((b->b_bufdrv == drv) && (b->b_buftyp == buftype) && (b->b_bufrec == recnum))
+            goto found;
+
+        stamp = is_cbcb(b) ? ((CBCB *)b)->c_lastuse : 0UL;
+        total++;
+        if (!lru || (stamp < oldest))
+        {
+            lru = b;
+            oldest = stamp;
+        }
+        if (b->b_buftyp == buftype)
+        {
+            ntyp++;
+            if (!lrutyp || (stamp < oldtyp))
+            {
+                lrutyp = b;
+                oldtyp = stamp;
+            }
+        }
+    }
+
+    /*
+     * not in memory.  If there was an 'empty' buffer, use it.  Otherwise,
+     * if this type of buffer has reached its quota, reuse the least
+     * recently used buffer of this type, else the least recently used.
+     */
+    if (mtbuf)
+        b = mtbuf;
+    else
+    {
+        b = (lrutyp && (ntyp >= QUOTA(total))) ? lrutyp : lru;
+        bcstat.bc_evictions++;
+#if CONF_WITH_LAZY_WRITEBACK
+        if (!b->b_dirty && is_cbcb(b) && ((CBCB *)b)->c_lazy)
+            bcstat.bc_lazysaved++;
+#endif
+    }
+    bcstat.bc_misses++;
+
+doio:
+    /*
+     * if the buffer is dirty, flush it (together with the other dirty
+     * buffers for that drive in the list), then read in the new record
+     */
+    if ((b->b_bufdrv != -1) && b->b_dirty)
+        flush_list(*phdr, b->b_bufdrv);
+    b->b_bufdrv = -1;       /* in case longjmp_rwabs() fails */
+    if (is_cbcb(b))
+    {
+        c = (CBCB *)b;
+        unhash(c);
+#if CONF_WITH_READAHEAD
+        if (c->c_ahead)
+        {
+            c->c_ahead = FALSE;
+            bcstat.bc_rawaste++;
+        }
+#endif
+#if CONF_WITH_LAZY_WRITEBACK
+        c->c_lazy = FALSE;
+#endif
+    }
+    longjmp_rwabs(0, (long)b->b_bufr, 1, recnum+dmd->m_recoff[buftype], drv);
+
+    /*
+     * make the new buffer current
+     */
+    b->b_bufrec = recnum;
+    b->b_dirty = 0;
+    b->b_buftyp = buftype;
+    b->b_bufdrv = drv;
+    b->b_dm = dmd;
+
+    if (is_cbcb(b))
+    {
+        c = (CBCB *)b;
+        c->c_hash = h;
+        c->c_hlink = bcbhash[h];
+        bcbhash[h] = c;
+    }
+    goto done;
+
+found:
+    /* use a buffer, but first validate media */
+    err = Mediach(b->b_bufdrv);
+    if (err != 0) {
+        if (err == 1) {
+            bcstat.bc_misses++;
+            goto doio; /* media may be changed */
+        } else if (err == 2) {
+            /* media definitely changed */
+            errdrv = b->b_bufdrv;
+            rwerr = E_CHNG; /* media change */
+            errcode = rwerr;
+            longjmp(errbuf,1);
+        }
+    }
+    bcstat.bc_hits++;
+
+done:
+    if (is_cbcb(b))
+    {
+        c = (CBCB *)b;
+        c->c_lastuse = ++bcb_clock;
+#if CONF_WITH_READAHEAD
+        if (c->c_ahead)
+        {
+            c->c_ahead = FALSE;
+            bcstat.bc_rahits++;
+        }
+#endif
+    }
+
+    return b;
+}
+#else
 BCB *getbcb(DMD *dmd,WORD buftype,RECNO recnum)
 {
     BCB *b;
@@ -196,6 +943,171 @@ doio:   for (p = *(q = phdr); p->b_link; p = *(q = &p->b_link))
 
     return b;
 }
+#endif /* CONF_WITH_BDOS_CACHE */
+
+
+#if CONF_WITH_READAHEAD
+/*
+ * ra_victim - get a buffer from the dir/data list to read ahead into:
+ * the first invalid one, or else the least recently used clean one.
+ * foreign BCBs are never used.  returns NULL if there is none.
+ */
+static CBCB *ra_victim(void)
+{
+    BCB *b;
+    CBCB *c, *lru = NULL;
+
+    for (b = bufl[BI_DATA]; b; b = b->b_link)
+    {
+        if (!is_cbcb(b))
+            continue;
+        c = (CBCB *)b;
+        if (b->b_bufdrv == -1)
+            return c;
+        if (b->b_dirty)
+            continue;
+        if (!lru || (c->c_lastuse < lru->c_lastuse))
+            lru = c;
+    }
+
+    return lru;
+}
+
+
+/*
+ * ra_present - return TRUE iff a data record is in any buffer of the
+ * dir/data list
+ *
+ * unlike hashfind(), this also finds foreign BCBs, and ours whose
+ * fields were changed behind our back.  reading such a record again
+ * would create a second copy, which may be older than the first.
+ */
+static BOOL ra_present(WORD drv, RECNO recnum)
+{
+    BCB *b;
+
+    for (b = bufl[BI_DATA]; b; b = b->b_link)
+        if ((b->b_bufdrv == drv) && (b->b_buftyp == BT_DATA) && (b->b_bufrec == recnum))
+            return TRUE;
+
+    return FALSE;
+}
+
+
+/*
+ * bufl_readahead - read data records into the cache ahead of time
+ *
+ * up to 'n' records starting at 'recnum' are considered.  records at
+ * the start that are already in a buffer (clean or dirty) are skipped,
+ * and the following records that are not are read with a single Rwabs()
+ * via the staging buffer.  errors are ignored, and not reported to the
+ * critical error handler either: if the records are really needed, the
+ * error will be reported then.
+ */
+void bufl_readahead(DMD *dm, RECNO recnum, WORD n)
+{
+    CBCB *c;
+    BCB *b;
+    UBYTE *p;
+    RECNO rec;
+    WORD drv, i;
+    long rc;
+
+    if (!flushbuf)
+        return;
+
+    drv = dm->m_drvnum;
+    for ( ; n > 0; n--, recnum++)
+        if (!ra_present(drv,recnum))
+            break;
+    if (n <= 0)
+        return;
+
+    if (n > FLUSHBUF_SIZE / dm->m_recsiz)
+        n = FLUSHBUF_SIZE / dm->m_recsiz;
+    for (i = 1; i < n; i++)
+        if (ra_present(drv,recnum+i))
+            break;
+    n = i;
+
+    rec = recnum + dm->m_recoff[BT_DATA];
+    rwabs_calls++;
+    if (rec <= 32767)
+        rc = Rwabs(0|RW_NOCRITIC, (long)flushbuf, n, rec, drv, 0);
+    else rc = Rwabs(0|RW_NOCRITIC, (long)flushbuf, n, -1, drv, rec);
+    if (rc)
+        return;
+
+    for (i = 0, p = flushbuf; i < n; i++, p += dm->m_recsiz)
+    {
+        c = ra_victim();
+        if (!c)
+            break;
+
+        b = &c->c_bcb;
+        if (b->b_bufdrv != -1)
+            bcstat.bc_evictions++;
+        if (c->c_ahead)
+            bcstat.bc_rawaste++;
+        unhash(c);
+#if CONF_WITH_LAZY_WRITEBACK
+        c->c_lazy = FALSE;
+#endif
+
+        memcpy(b->b_bufr, p, dm->m_recsiz);
+        b->b_bufrec = recnum + i;
+        b->b_dirty = 0;
+        b->b_buftyp = BT_DATA;
+        b->b_bufdrv = drv;
+        b->b_dm = dm;
+
+        c->c_hash = BCBHASH(drv,BT_DATA,recnum+i);
+        c->c_hlink = bcbhash[c->c_hash];
+        bcbhash[c->c_hash] = c;
+        c->c_lastuse = ++bcb_clock;
+        c->c_ahead = TRUE;
+        bcstat.bc_rarecs++;
+    }
+}
+
+
+/*
+ * bufl_read - copy data records from the cache to the user's buffer
+ *
+ * copies records starting at 'recnum' until one is found that is not
+ * cached (or 'n' have been copied).  returns the number copied.
+ */
+WORD bufl_read(DMD *dm, RECNO recnum, WORD n, UBYTE *ubuf)
+{
+    CBCB *c;
+    WORD drv, i;
+
+    drv = dm->m_drvnum;
+    if (!hashfind(drv,BT_DATA,recnum))
+        return 0;
+
+    /* as in getbcb(), validate the media before using the buffers */
+    if (Mediach(drv) != 0)
+        return 0;
+
+    for (i = 0; i < n; i++, ubuf += dm->m_recsiz)
+    {
+        c = hashfind(drv,BT_DATA,recnum+i);
+        if (!c)
+            break;
+        memcpy(ubuf, c->c_bcb.b_bufr, dm->m_recsiz);
+        c->c_lastuse = ++bcb_clock;
+        bcstat.bc_hits++;
+        if (c->c_ahead)
+        {
+            c->c_ahead = FALSE;
+            bcstat.bc_rahits++;
+        }
+    }
+
+    return i;
+}
+#endif /* CONF_WITH_READAHEAD */
 
 
 /*
@@ -205,6 +1117,9 @@ UBYTE *getrec(RECNO recn, OFD *of, int wrtflg)
 {
     DMD *dm = of->o_dmd;
     BCB *b;
+#if CONF_WITH_LAZY_WRITEBACK
+    CBCB *c;
+#endif
     int n;
 
     KDEBUG(("getrec 0x%lx, %p, 0x%x\n",recn,dm,wrtflg));
@@ -218,13 +1133,43 @@ UBYTE *getrec(RECNO recn, OFD *of, int wrtflg)
 
     KDEBUG(("n=%i, dm->m_recoff[n]=0x%lx\n",n,dm->m_recoff[n]));
 
+#if CONF_WITH_BDOS_CACHE
+    /*
+     * write back FAT records that have been dirty for too long
+     */
+    if (fat_dirty && (hz_200 - fat_dirty_time > FATDELAY))
+    {
+        fat_dirty = FALSE;
+        flush_list(bufl[BI_FAT], -1);
+    }
+#endif
+
     b = getbcb(dm,n,recn);          /* get BCB for buffer */
 
     /*
      * if we are writing to the buffer, dirty it
      */
     if (wrtflg)
+    {
+#if CONF_WITH_LAZY_WRITEBACK
+        if (is_cbcb(b))
+        {
+            c = (CBCB *)b;
+            if (!b->b_dirty)
+                c->c_dirtytime = hz_200;
+            c->c_lazy = FALSE;
+            lazy_dirty = TRUE;
+        }
+#endif
         b->b_dirty = 1;
+#if CONF_WITH_BDOS_CACHE
+        if ((n == BT_FAT) && !fat_dirty)
+        {
+            fat_dirty = TRUE;
+            fat_dirty_time = hz_200;
+        }
+#endif
+    }
 
     return b->b_bufr;
 }
@@ -125,6 +125,7 @@
 #include "fs.h"
 #include "time.h"
 #include "mem.h"
+#include "proc.h"
 #include "gemerror.h"
 #include "biosbind.h"
 #include "string.h"
@@ -134,8 +135,6 @@
 
 #define ROOT_PSEUDO_CLUSTER 1   /* see comments in xrename() */
 
-#define DIR_FILE_LENGTH 0x7fffffffL     /* fake size for directories */
-
 /*
  * forward prototypes
  */
@@ -169,6 +168,73 @@ static const char dots[22] = ".          ";
  */
 static LONG freed_dnds, freed_ofds; /* count of DNDs & OFDs made available */
 
+#if CONF_WITH_DIR_CACHE
+/*
+ *  directory lookup cache
+ *
+ *  this remembers where scan() found (or did not find) a name in a
+ *  directory, so that the next lookup of that name need not read the
+ *  directory from the start.  a directory is identified by its drive
+ *  and starting cluster (0 for the root) rather than by its DND, since
+ *  DNDs are scavenged and reused (see makdnd()).
+ *
+ *  a positive entry holds the position of the FCB in the directory.
+ *  it is always checked against the FCB itself before it is used, so
+ *  it does no harm if the directory has changed since.  a negative entry
+ *  means that the name is not in the directory at all; it must be
+ *  dropped (via dcache_drop()) when the name is created.
+ */
+#define DC_ENTRIES      64      /* number of cache entries */
+#define DC_HASHSIZE     32      /* must be a power of 2 */
+#define DC_ABSENT       (-1L)   /* dc_pos value for a negative entry */
+#define DC_UNKNOWN      (-2L)   /* returned by dc_lookup() for a miss */
+
+typedef struct _dcent DCENT;
+struct _dcent
+{
+    DCENT *dc_next;         /* next entry in hash chain */
+    DMD   *dc_dmd;          /* drive, or NULL if entry is unused */
+    CLNO  dc_dircl;         /* starting cluster of directory */
+    LONG  dc_pos;           /* position of FCB, or DC_ABSENT */
+    ULONG dc_used;          /* time of last use, for LRU replacement */
+    char  dc_name[FNAMELEN];
+};
+
+static DCENT dcent[DC_ENTRIES];
+static DCENT *dchash[DC_HASHSIZE];
+static ULONG dc_clock;
+
+/*
+ *  directory name summaries
+ *
+ *  a summary is a bit map for one directory, with two bits set for each
+ *  name in it, chosen by a hash of the name.  if either bit for a name
+ *  is clear, the name is certainly not in the directory.  this lets
+ *  ixcreat() check that a new name does not exist without reading the
+ *  whole directory each time, which made filling a big directory
+ *  quadratic.
+ *
+ *  a summary is built by scan() when it looks up a name and reads the
+ *  directory from the start to the end.  like a negative cache entry,
+ *  it relies on dcache_drop() being called whenever a name is created;
+ *  names that are deleted just leave their bits set.
+ */
+#define DS_ENTRIES      2       /* number of summaries */
+#define DS_BITS         2048    /* bits per summary: must be a power of 2 */
+
+typedef struct _dsum DSUM;
+struct _dsum
+{
+    DMD   *ds_dmd;          /* drive, or NULL if entry is unused */
+    CLNO  ds_dircl;         /* starting cluster of directory */
+    ULONG ds_used;          /* time of last use, for LRU replacement */
+    UBYTE ds_map[DS_BITS/8];
+};
+
+static DSUM dsum[DS_ENTRIES];
+static UBYTE ds_build[DS_BITS/8];   /* summary being built by scan() */
+#endif
+
 
 /*
  *  namlen - parameter points to a character string of FNAMELEN bytes max
@@ -203,7 +269,7 @@ long xmkdir(char *s)
     DFD *dfd;
     FCB *fcb1,*fcb2;
     DND *dn;
-    int h,cl,plen;
+    int h,plen;
     long rc;
 
     if ((h = rc = ixcreat(s,FA_SUBDIR)) < 0)
@@ -247,9 +313,7 @@ long xmkdir(char *s)
     fcb2->f_attrib = FA_SUBDIR;
     dfd = f0->o_dfd;
     fcb2->f_td = dfd->o_td;         /* time/date are little-endian */
-    cl = dfd->o_strtcl;
-    swpw(cl);
-    fcb2->f_clust = cl;
+    setfcbcl(fcb2,dfd->o_strtcl,dn->d_drv);
     fcb2->f_fileln = 0;
     fcb2++;
 
@@ -258,18 +322,17 @@ long xmkdir(char *s)
     fcb2->f_name[1] = '.';          /* This is .. */
     fcb2->f_attrib = FA_SUBDIR;
     /* if creating a folder in the root, the parent entry needs special handling */
-    if (!fd->o_dnode)
+    if (!f->o_dnode->d_parent)
     {
         fcb2->f_td.time = 0;        /* time/date of parent must be zero */
         fcb2->f_td.date = 0;
-        fcb2->f_clust = 0;          /* cluster number is zero too */
+        setfcbcl(fcb2,0,dn->d_drv); /* cluster number is zero too */
     }
     else
     {
         dfd = f->o_dirfil->o_dfd;
         fcb2->f_td = dfd->o_td;     /* time/date are little-endian */
-        fcb2->f_clust = dfd->o_strtcl;
-        swpw(fcb2->f_clust);
+        setfcbcl(fcb2,dfd->o_strtcl,dn->d_drv);
     }
     fcb2->f_fileln = 0;
     memcpy(f, f0, sizeof(OFD));
@@ -483,6 +546,9 @@ long ixsfirst(char *name, WORD att, DTAINFO *addr)
             addr->dt_offset_drive = 0L;
             addr->dt_cloffset = ofd->o_curbyt;
             addr->dt_clnum = ofd->o_curcl;
+#if CONF_WITH_FAT32
+            addr->dt_offset_drive = ofd->o_curcl & 0xffff0000L;
+#endif
         }
         addr->dt_offset_drive |= dn->d_drv->m_drvnum & DTA_DRIVEMASK;
         addr->dt_attr = att;
@@ -576,6 +642,9 @@ static FCB *ixsnext(DTAINFO *dt)
         buftype = BT_DATA;
         offset = dt->dt_cloffset;       /* within cluster */
         cluster = dt->dt_clnum;
+#if CONF_WITH_FAT32
+        cluster |= dt->dt_offset_drive & 0xffff0000L;
+#endif
         recnum = cl2rec(cluster,dmd) + (offset >> dmd->m_rblog);
         offset &= dmd->m_rbm;           /* within record */
     }
@@ -636,6 +705,9 @@ static FCB *ixsnext(DTAINFO *dt)
     {
         dt->dt_cloffset = ((recnum&dmd->m_clrm) << dmd->m_rblog) + offset;
         dt->dt_clnum = cluster;
+#if CONF_WITH_FAT32
+        dt->dt_offset_drive = (cluster & 0xffff0000L) | dmd->m_drvnum;
+#endif
     }
 
     return fcb;
@@ -674,6 +746,89 @@ long xsnext(void)
 }
 
 
+#if CONF_WITH_FSLIST
+/*
+ *  xslist - Function 0x59 (Fslist) - EmuTOS extension
+ *
+ *  like Fsfirst()/Fsnext(), but returns as many matching entries as
+ *  will fit in the buffer.  buf->fl_cookie must be 0 for the first
+ *  call; on return, it is the value to use to continue the search, or
+ *  0 if the end of the directory has been reached.
+ *
+ *  returns the number of entries, or a negative error code
+ *
+ *  Error returns:  EPTHNF, ERANGE
+ */
+long xslist(char *name, int att, FSLIST *buf, long len)
+{
+    char s[FNAMELEN+1];
+    const char *sp;
+    DND *dn;
+    OFD *fd;
+    FCB *fcb;
+    FSENTRY *fe;
+    long pos;
+    WORD n, max;
+
+    len = (len - (long)sizeof(FSLIST)) / (long)sizeof(FSENTRY);
+    if (len <= 0)
+        return ERANGE;
+    max = (len > 0x7fff) ? 0x7fff : len;
+
+    pos = buf->fl_cookie;
+    if ((pos < 0) || (pos & (sizeof(FCB)-1)))
+        return ERANGE;
+
+    if (att != FA_VOL)
+        att |= (FA_ARCHIVE|FA_RO);
+
+    dn = findit(name,&sp,0);
+    if (!dn)
+        return EPTHNF;
+
+    builds(sp,s);
+    s[FNAMELEN] = att;
+
+    if (!(fd = dn->d_ofd))
+        fd = makofd(dn);    /* makofd() also updates dn->d_ofd */
+
+    if (ixlseek(fd,pos) < 0)
+        return ERANGE;
+
+    for (n = 0, fe = (FSENTRY *)(buf+1); n < max; )
+    {
+        if ((fd->o_bytnum >= fd->o_dfd->o_fileln)   /* end of root */
+         || !(fcb = ixgetfcb(fd)) || !fcb->f_name[0])
+        {
+            pos = 0L;       /* end of directory */
+            break;
+        }
+        pos = fd->o_bytnum;
+
+        if (match(s,fcb->f_name))
+        {
+            fe->fe_reserved = 0;
+            fe->fe_attr = fcb->f_attrib;
+            fe->fe_time = fcb->f_td.time;
+            swpw(fe->fe_time);
+            fe->fe_date = fcb->f_td.date;
+            swpw(fe->fe_date);
+            fe->fe_length = fcb->f_fileln;
+            swpl(fe->fe_length);
+            packit(fcb->f_name,fe->fe_name);
+            fe++;
+            n++;
+        }
+    }
+
+    buf->fl_cookie = pos;
+    buf->fl_count = n;
+
+    return n;
+}
+#endif
+
+
 /*
  *  xgsdtof - get/set date/time of file into or from buffer
  *
@@ -694,6 +849,9 @@ long xgsdtof(DOSTIME *buf, int h, int wrt)
         swpcopyw(&buf->time, &dfd->o_td.time);
         swpcopyw(&buf->date, &dfd->o_td.date);
         dfd->o_flag |= O_DIRTY;         /* M01.01.0918.01 */
+#if CONF_WITH_PEXEC_CACHE
+        pxcache_forget(f->o_dnode, f->o_dirbyt);
+#endif
     }
     else
     {
@@ -897,13 +1055,13 @@ long xrename(int n, char *p1, char *p2)
     FCB *fcb;
     DND *dn1, *dn2;
     DMD *dmd1, *dmd2;
-    CLNO strtcl1, strtcl2, temp;
+    CLNO strtcl1, strtcl2, parentcl;
     const char *s1, *s2;
     char buf[FNAMELEN];
     UBYTE att;
     int hnew;
     long posp;
-    UWORD filetime, filedate;
+    UWORD filetime, filedate, temp;
     CLNO clust;
     LONG fileln;
 
@@ -955,8 +1113,7 @@ long xrename(int n, char *p1, char *p2)
     swpw(filetime);             /* convert from little-endian format */
     filedate = fcb->f_td.date;
     swpw(filedate);
-    clust = fcb->f_clust;
-    swpw(clust);
+    clust = getfcbcl(fcb,dmd1);
     fileln = fcb->f_fileln;
     swpl(fileln);
 
@@ -1023,6 +1180,8 @@ long xrename(int n, char *p1, char *p2)
             KDEBUG(("xrename(): can't erase old entry\n"));
             return EACCDN;
         }
+        if (posp < dn1->d_free)
+            dn1->d_free = posp;
 
         /* copy the time/date/cluster/length to the OFD */
         dfd = fd2->o_dfd;
@@ -1045,14 +1204,24 @@ long xrename(int n, char *p1, char *p2)
              * note that the root dir has a cluster# of zero.
              */
             if (!fd2->o_dnode->d_name[0])   /* empty name means root */
-                temp = 0;
-            else temp = fdparent->o_dfd->o_strtcl;  /* else real start cluster */
+                parentcl = 0;
+            else parentcl = fdparent->o_dfd->o_strtcl;  /* else real start cluster */
+            temp = parentcl;
             swpw(temp);                     /* convert to disk format */
             if (update_fcb(fd2,sizeof(FCB)+26,2L,(UBYTE *)&temp) < 0)
             {
                 KDEBUG(("xrename(): can't update .. entry\n"));
                 return EINTRN;
             }
+#if CONF_WITH_FAT32
+            temp = parentcl >> 16;          /* high word of cluster */
+            swpw(temp);
+            if (dmd2->m_32 && (update_fcb(fd2,sizeof(FCB)+20,2L,(UBYTE *)&temp) < 0))
+            {
+                KDEBUG(("xrename(): can't update .. entry\n"));
+                return EINTRN;
+            }
+#endif
 
             /* set attribute for this file in parent directory */
             if (update_fcb(fdparent,fd2->o_dirbyt+FNAMELEN,1L,&att) < 0)
@@ -1078,6 +1247,9 @@ long xrename(int n, char *p1, char *p2)
             KDEBUG(("xrename(): can't update FCB with new name\n"));
             return EACCDN;
         }
+#if CONF_WITH_DIR_CACHE
+        dcache_drop(dn1,buf);       /* the new name now exists */
+#endif
     }
 
     /*
@@ -1513,6 +1685,312 @@ DND *findit(char *name, const char **sp, int dflag)
  */
 
 
+#if CONF_WITH_DIR_CACHE
+/*
+ *  dc_samename - check if an FCB has the specified (non-wildcard) name
+ *
+ *  deleted entries and VFAT long file name entries never match
+ */
+static BOOL dc_samename(const char *name, const char *fcbname)
+{
+    int i;
+
+    if ((fcbname[0] == ERASE_MARKER) || (fcbname[FNAMELEN] == FA_LFN))
+        return FALSE;
+
+    for (i = 0; i < FNAMELEN; i++)
+        if (toupper(name[i]) != toupper(fcbname[i]))
+            return FALSE;
+
+    return TRUE;
+}
+
+
+/*
+ *  dc_dircl - return the cluster number identifying a directory
+ */
+static CLNO dc_dircl(DND *dn)
+{
+    if (!dn->d_parent)
+        return 0;
+
+    /* the DND is not updated when a new directory gets its first cluster */
+    return dn->d_ofd ? dn->d_ofd->o_dfd->o_strtcl : dn->d_strtcl;
+}
+
+
+/*
+ *  dc_chain - return the hash chain for a name in a directory
+ */
+static DCENT **dc_chain(DMD *dm, CLNO cl, const char *name)
+{
+    UWORD h;
+    int i;
+
+    h = dm->m_drvnum + cl;
+    for (i = 0; i < FNAMELEN; i++)
+        h = (h << 1) + toupper(name[i]);
+
+    return &dchash[h & (DC_HASHSIZE-1)];
+}
+
+
+/*
+ *  dc_find - find the cache entry for a name in a directory, or NULL
+ */
+static DCENT *dc_find(DND *dn, const char *name)
+{
+    DCENT *d;
+    DMD *dm = dn->d_drv;
+    CLNO cl = dc_dircl(dn);
+
+    for (d = *dc_chain(dm,cl,name); d; d = d->dc_next)
+        if ((d->dc_dmd == dm) && (d->dc_dircl == cl)
+         && (strncasecmp(d->dc_name,name,FNAMELEN) == 0))
+            return d;
+
+    return NULL;
+}
+
+
+/*
+ *  dc_unhash - remove an entry from its hash chain & mark it unused
+ */
+static void dc_unhash(DCENT *d)
+{
+    DCENT **prev;
+
+    for (prev = dc_chain(d->dc_dmd,d->dc_dircl,d->dc_name); *prev; prev = &(*prev)->dc_next)
+    {
+        if (*prev == d)
+        {
+            *prev = d->dc_next;
+            break;
+        }
+    }
+    d->dc_dmd = NULL;
+}
+
+
+/*
+ *  dc_lookup - look up a name in the cache
+ *
+ *  returns the position of the FCB, DC_ABSENT if the name is known not
+ *  to be in the directory, or DC_UNKNOWN
+ */
+static LONG dc_lookup(DND *dn, const char *name)
+{
+    DCENT *d;
+
+    if (dn->d_parent && !dc_dircl(dn))
+        return DC_UNKNOWN;
+
+    d = dc_find(dn,name);
+    if (!d)
+        return DC_UNKNOWN;
+
+    d->dc_used = ++dc_clock;
+
+    return d->dc_pos;
+}
+
+
+/*
+ *  dc_add - add or update the cache entry for a name
+ *
+ *  if the cache is full, the least recently used entry is replaced
+ */
+static void dc_add(DND *dn, const char *name, LONG pos)
+{
+    DCENT *d, *victim;
+    DCENT **chain;
+
+    if (dn->d_parent && !dc_dircl(dn))
+        return;
+
+    d = dc_find(dn,name);
+    if (!d)
+    {
+        for (d = dcent, victim = dcent; d < dcent+DC_ENTRIES; d++)
+        {
+            if (!d->dc_dmd)
+            {
+                victim = d;
+                break;
+            }
+            if (d->dc_used < victim->dc_used)
+                victim = d;
+        }
+        d = victim;
+        if (d->dc_dmd)
+            dc_unhash(d);
+
+        d->dc_dmd = dn->d_drv;
+        d->dc_dircl = dc_dircl(dn);
+        memcpy(d->dc_name,name,FNAMELEN);
+        chain = dc_chain(d->dc_dmd,d->dc_dircl,d->dc_name);
+        d->dc_next = *chain;
+        *chain = d;
+    }
+
+    d->dc_pos = pos;
+    d->dc_used = ++dc_clock;
+}
+
+
+/*
+ *  ds_bits - return the numbers of the two summary bits for a name,
+ *  packed into a ULONG
+ */
+static ULONG ds_bits(const char *name)
+{
+    ULONG h;
+    int i;
+
+    for (i = 0, h = 0UL; i < FNAMELEN; i++)
+        h = (h << 5) + h + toupper(name[i]);
+
+    return h & (((ULONG)(DS_BITS-1) << 16) | (DS_BITS-1));
+}
+
+#define DS_TEST(map,bit)    ((map)[(bit)>>3] & (1 << ((bit)&7)))
+#define DS_SET(map,bit)     ((map)[(bit)>>3] |= (1 << ((bit)&7)))
+
+
+/*
+ *  ds_mark - set the bits for a name in a summary map
+ */
+static void ds_mark(UBYTE *map, const char *name)
+{
+    ULONG bits = ds_bits(name);
+
+    DS_SET(map,LOWORD(bits));
+    DS_SET(map,HIWORD(bits));
+}
+
+
+/*
+ *  ds_absent - check if a summary shows that a name is not there
+ */
+static BOOL ds_absent(const DSUM *ds, const char *name)
+{
+    ULONG bits = ds_bits(name);
+
+    return !DS_TEST(ds->ds_map,LOWORD(bits)) || !DS_TEST(ds->ds_map,HIWORD(bits));
+}
+
+
+/*
+ *  ds_find - find the summary for a directory, or NULL
+ */
+static DSUM *ds_find(DND *dn)
+{
+    DSUM *ds;
+    CLNO cl;
+
+    if (dn->d_parent && !dc_dircl(dn))
+        return NULL;
+
+    cl = dc_dircl(dn);
+    for (ds = dsum; ds < dsum+DS_ENTRIES; ds++)
+    {
+        if ((ds->ds_dmd == dn->d_drv) && (ds->ds_dircl == cl))
+        {
+            ds->ds_used = ++dc_clock;
+            return ds;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ *  ds_add - make ds_build[] the summary for a directory
+ *
+ *  if all summaries are in use, the least recently used one is replaced
+ */
+static void ds_add(DND *dn)
+{
+    DSUM *ds, *victim;
+
+    if (dn->d_parent && !dc_dircl(dn))
+        return;
+
+    for (ds = dsum, victim = dsum; ds < dsum+DS_ENTRIES; ds++)
+    {
+        if (!ds->ds_dmd)
+        {
+            victim = ds;
+            break;
+        }
+        if (ds->ds_used < victim->ds_used)
+            victim = ds;
+    }
+
+    victim->ds_dmd = dn->d_drv;
+    victim->ds_dircl = dc_dircl(dn);
+    victim->ds_used = ++dc_clock;
+    memcpy(victim->ds_map,ds_build,sizeof(ds_build));
+}
+
+
+/*
+ *  dcache_drop - forget about a name in a directory
+ *
+ *  this must be called whenever a name is created in a directory
+ */
+void dcache_drop(DND *dn, const char *name)
+{
+    DCENT *d;
+    DSUM *ds;
+
+    d = dc_find(dn,name);
+    if (d)
+        dc_unhash(d);
+
+    ds = ds_find(dn);
+    if (ds)
+        ds_mark(ds->ds_map,name);
+}
+
+
+/*
+ *  dcache_purge - forget about all the names on a drive
+ *
+ *  this must be called before the DMD for the drive is freed
+ */
+void dcache_purge(DMD *dm)
+{
+    DCENT *d;
+    DSUM *ds;
+
+    for (d = dcent; d < dcent+DC_ENTRIES; d++)
+        if (d->dc_dmd == dm)
+            dc_unhash(d);
+
+    for (ds = dsum; ds < dsum+DS_ENTRIES; ds++)
+        if (ds->ds_dmd == dm)
+            ds->ds_dmd = NULL;
+}
+
+
+/*
+ *  dc_wild - check for wildcards in an FCB-style name
+ */
+static BOOL dc_wild(const char *name)
+{
+    int i;
+
+    for (i = 0; i < FNAMELEN; i++)
+        if (name[i] == '?')
+            return TRUE;
+
+    return FALSE;
+}
+#endif /* CONF_WITH_DIR_CACHE */
+
+
 /*
  *  scan - scan a directory for an entry with the desired name.
  *      scans a directory indicated by a DND.  attributes figure in matching
@@ -1527,6 +2005,14 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
     OFD *fd;
     DND *dnd1;
     BOOL m;                 /*  T: found a matching FCB             */
+    BOOL fromstart;
+    BOOL hit;               /*  T: answered by the directory cache  */
+    LONG freepos;
+#if CONF_WITH_DIR_CACHE
+    BOOL cacheable, build;
+    LONG pos, seen;
+    DSUM *ds;
+#endif
 
     KDEBUG(("scan(%p,'%s',0x%x,%p)\n",dnd,n,att,posp));
 
@@ -1548,12 +2034,65 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
      *  the beginning.
      */
     ixlseek(fd, (*posp == -1) ? 0L : *posp);
+    fromstart = (fd->o_bytnum == 0L);
+    freepos = -1L;
+    hit = FALSE;
+
+#if CONF_WITH_DIR_CACHE
+    /*
+     *  if we are looking for a specific name from the start of the
+     *  directory, the cache may know where it is, or that it isn't there
+     */
+    cacheable = ((*posp == 0) || (*posp == -1)) && (*n != ERASE_MARKER) && !dc_wild(name);
+    seen = DC_ABSENT;
+    fcb = NULL;
+    build = FALSE;
+    if (cacheable)
+    {
+        ds = ds_find(dnd);
+        pos = dc_lookup(dnd,name);
+        if ((pos == DC_UNKNOWN) && ds && ds_absent(ds,name))
+            pos = DC_ABSENT;
+        if (pos == DC_ABSENT)
+        {
+            /* nothing to scan: we learn nothing about free entries */
+            hit = TRUE;
+            fromstart = FALSE;
+        }
+        else if (pos >= 0)
+        {
+            fcb = (ixlseek(fd,pos) < 0) ? NULL : ixgetfcb(fd);
+            if (fcb && dc_samename(name,fcb->f_name) && match(name,fcb->f_name))
+            {
+                hit = m = TRUE;
+                fromstart = FALSE;
+                if ((fcb->f_attrib & FA_SUBDIR) && (fcb->f_name[0] != '.'))
+                {
+                    dnd1 = getdnd(&fcb->f_name[0], dnd);
+                    if (!dnd1)
+                        dnd1 = makdnd(dnd,fcb);   /* always succeeds */
+                }
+            }
+            else ixlseek(fd,0L);    /* out of date, so scan as usual */
+        }
+
+        /* if we must read the whole directory, summarise it on the way */
+        build = !hit && !ds;
+        if (build)
+            bzero(ds_build,sizeof(ds_build));
+    }
+#endif
 
     /*
      *  scan thru the directory file, looking for a match
      */
-    while ((fcb = ixgetfcb(fd)) && (fcb->f_name[0]))
+    while (!hit && !m && (fcb = ixgetfcb(fd)) && (fcb->f_name[0]))
     {
+#if CONF_WITH_DIR_CACHE
+        if (build && (fcb->f_name[0] != ERASE_MARKER))
+            ds_mark(ds_build,fcb->f_name);
+#endif
+
         /*
          *  Add New DND.
          *  ( iff after scan ptr && not a .
@@ -1570,6 +2109,43 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
 
         if ((m = match(name, fcb->f_name)))
              break;
+
+        /* remember the first free entry (see below) */
+        if ((freepos < 0) && (fcb->f_name[0] == ERASE_MARKER))
+            freepos = fd->o_bytnum - sizeof(FCB);
+
+#if CONF_WITH_DIR_CACHE
+        /* remember the first entry with this name, even if the attributes don't match */
+        if (cacheable && (seen == DC_ABSENT) && dc_samename(name,fcb->f_name))
+            seen = fd->o_bytnum - sizeof(FCB);
+#endif
+    }
+
+#if CONF_WITH_DIR_CACHE
+    if (cacheable && !hit)
+        dc_add(dnd, name, m ? fd->o_bytnum - sizeof(FCB) : seen);
+    if (build && !m)        /* we have seen every name in the directory */
+        ds_add(dnd);
+#endif
+
+    /*
+     *  if we scanned from the start of the directory, we know where
+     *  the first free entry is, or at least that all the entries we
+     *  have seen are in use: update the DND's free entry hint
+     */
+    if (fromstart)
+    {
+        if ((freepos < 0) && fcb && !fcb->f_name[0])
+            freepos = fd->o_bytnum - sizeof(FCB);   /* end of directory */
+        if (freepos >= 0)
+            dnd->d_free = freepos;
+        else
+        {
+            /* a matching entry may itself be free (see ixcreat()) */
+            freepos = m ? fd->o_bytnum - sizeof(FCB) : fd->o_bytnum;
+            if (freepos > dnd->d_free)
+                dnd->d_free = freepos;
+        }
     }
 
     KDEBUG(("\n   scan(pos=%ld DND=%p DNDfoundFile=%p name=%s name=%s, %d)",
@@ -1665,11 +2241,11 @@ static DND *makdnd(DND *p, FCB *fcb)
     /* complete the initialization */
 
     p1->d_ofd = (OFD *) 0;
-    p1->d_strtcl = fcb->f_clust;
-    swpw(p1->d_strtcl);
+    p1->d_strtcl = getfcbcl(fcb,p->d_drv);
     p1->d_drv = p->d_drv;
     p1->d_dirfil = fd;
     p1->d_dirpos = fd->o_bytnum - sizeof(FCB);
+    p1->d_free = 0L;
     p1->d_td.time = fcb->f_td.time; /* note: DND time/date are  */
     p1->d_td.date = fcb->f_td.date; /*  actually little-endian! */
     memcpy(p1->d_name, fcb->f_name, FNAMELEN);
@@ -185,12 +185,28 @@ WORD log_media(BPB *b, int drv)
     DFD *dfd;
     DND *d;
     DMD *dm;
-    unsigned long rsiz, cs, n, fs;
+    unsigned long rsiz, cs, n, fs, fatrec, datrec, numcl;
 
     rsiz = b->recsiz;
     cs = b->clsiz;
     n = b->rdlen;
     fs = b->fsiz;
+    fatrec = b->fatrec;
+    datrec = b->datrec;
+    numcl = b->numcl;
+
+#if CONF_WITH_FAT32
+    /* the 16-bit values in the BPB are not used for FAT32 */
+    if (b->b_flags & B_32)
+    {
+        BPB32 *b32 = (BPB32 *)b;
+
+        fs = b32->fsiz;
+        fatrec = b32->fatrec;
+        datrec = b32->datrec;
+        numcl = b32->numcl;
+    }
+#endif
 
     KDEBUG(("log_media(%p,%i) rsiz=0x%lx, cs=0x%lx, n=0x%lx, fs=0x%lx\n",
             b,drv,rsiz,cs,n,fs));
@@ -218,7 +234,7 @@ WORD log_media(BPB *b, int drv)
     dm->m_clsiz = cs;                   /*  set cluster size in sectors */
     dm->m_clsizb = b->clsizb;           /*    and in bytes              */
     dm->m_recsiz = rsiz;                /*  set record (sector) size    */
-    dm->m_numcl = b->numcl;             /*  set cluster size in records */
+    dm->m_numcl = numcl;                /*  set cluster size in records */
     dm->m_clrlog = log2ul(cs);          /*    and log of it             */
     dm->m_clrm = (1L<<dm->m_clrlog)-1;  /*      and mask of it          */
     dm->m_rblog = log2ul(rsiz);         /*  set log of bytes/record     */
@@ -229,6 +245,23 @@ WORD log_media(BPB *b, int drv)
     f->o_dfd = dfd = &f->o_disk;
     dfd->o_fileln = n * rsiz;           /*  size of file (root dir)     */
     d->d_strtcl = dfd->o_strtcl = 2;    /*  root start pseudo-cluster   */
+#if CONF_WITH_FAT32
+    /*
+     * on FAT32, the root directory is an ordinary cluster chain.  giving
+     * its OFD a dir node makes getrec() & nextcl() treat it as such.
+     */
+    dm->m_32 = (b->b_flags & B_32) ? 1 : 0;
+    dm->m_fsidirty = 0;
+    if (dm->m_32)
+    {
+        BPB32 *b32 = (BPB32 *)b;
+
+        dm->m_fsinfo = b32->fsinfo;
+        dfd->o_fileln = DIR_FILE_LENGTH;/*  fake size, as for subdirs   */
+        d->d_strtcl = dfd->o_strtcl = b32->rootcl;
+        f->o_dnode = d;
+    }
+#endif
 
     fo = dm->m_fatofd;                  /*  OFD for 'fat file'          */
     fo->o_dmd = dm;                     /*  link with DMD               */
@@ -236,9 +269,9 @@ WORD log_media(BPB *b, int drv)
     dfd->o_fileln = fs * rsiz;          /*  FAT size                    */
     dfd->o_strtcl = 2;                  /*  FAT start pseudo-cluster    */
 
-    dm->m_recoff[BT_FAT] = (RECNO)b->fatrec;
-    dm->m_recoff[BT_ROOT] = (RECNO)b->fatrec + fs;
-    dm->m_recoff[BT_DATA] = (RECNO)b->datrec;
+    dm->m_recoff[BT_FAT] = (RECNO)fatrec;
+    dm->m_recoff[BT_ROOT] = (RECNO)fatrec + fs;
+    dm->m_recoff[BT_DATA] = (RECNO)datrec;
 
     KDEBUG(("log_media(%i) dm->m_recoff[0-2] = 0x%lx/0x%lx/0x%lx\n",
             drv, dm->m_recoff[0],dm->m_recoff[1],dm->m_recoff[2]));
@@ -13,6 +13,202 @@
 #include "fs.h"
 #include "gemerror.h"
 #include "bdosstub.h"
+#include "mem.h"
+#include "string.h"
+
+#if CONF_WITH_FAT32
+/*
+ * FSInfo sector layout (all values are little-endian)
+ */
+#define FSI_SIG1        0x41615252L     /* at offset 0 */
+#define FSI_SIG2        0x61417272L     /* at offset 484 */
+#define FSI_SIG3        0xaa550000L     /* at offset 508 */
+#define FSI_OFF_SIG2    484
+#define FSI_OFF_FREE    488
+#define FSI_OFF_NEXT    492
+#define FSI_OFF_SIG3    508
+#define FSI_UNKNOWN     0xffffffffL     /* free count/hint not known */
+#endif
+
+/*
+ * fatoffset - return the byte offset within the FAT of (the start of)
+ * the FAT entry for cluster 'cl'
+ */
+static LONG fatoffset(LONG cl, DMD *dm)
+{
+#if CONF_WITH_FAT32
+    if (dm->m_32)
+        return cl << 2;
+#endif
+
+    return dm->m_16 ? cl << 1 : (cl + (cl >> 1));
+}
+
+#if CONF_WITH_FAT32
+/*
+ * fsinfo_buf - return the BCB for the FSInfo sector of a FAT32 drive,
+ * or NULL if there is no valid one
+ */
+static BCB *fsinfo_buf(DMD *dm)
+{
+    BCB *b;
+    ULONG sig1, sig2, sig3;
+
+    if (!dm->m_32 || !dm->m_fsinfo)
+        return NULL;
+
+    /* the record number wraps round to the right place in getbcb() */
+    b = getbcb(dm,BT_DATA,(RECNO)dm->m_fsinfo-dm->m_recoff[BT_DATA]);
+
+    sig1 = *(ULONG *)b->b_bufr;
+    sig2 = *(ULONG *)(b->b_bufr+FSI_OFF_SIG2);
+    sig3 = *(ULONG *)(b->b_bufr+FSI_OFF_SIG3);
+    swpl(sig1);
+    swpl(sig2);
+    swpl(sig3);
+
+    return ((sig1 == FSI_SIG1) && (sig2 == FSI_SIG2) && (sig3 == FSI_SIG3)) ? b : NULL;
+}
+
+/*
+ * fsinfo_get - get the free cluster count and/or the next free cluster
+ * hint from the FSInfo sector
+ *
+ * each value is only returned if it is present and plausible
+ */
+static void fsinfo_get(DMD *dm, CLNO *free, CLNO *next)
+{
+    BCB *b;
+    ULONG n;
+
+    b = fsinfo_buf(dm);
+    if (!b)
+        return;
+
+    if (free)
+    {
+        n = *(ULONG *)(b->b_bufr+FSI_OFF_FREE);
+        swpl(n);
+        if (n <= dm->m_numcl)
+            *free = n;
+    }
+
+    if (next)
+    {
+        n = *(ULONG *)(b->b_bufr+FSI_OFF_NEXT);
+        swpl(n);
+        if ((n >= 2) && (n <= dm->m_numcl+1))
+            *next = n;
+    }
+}
+
+/*
+ * fsinfo_update - update the FSInfo sector after the FAT has changed
+ *
+ * the free cluster count is only written if we know it, otherwise it
+ * is marked as unknown
+ */
+void fsinfo_update(DMD *dm)
+{
+    BCB *b;
+    ULONG free = FSI_UNKNOWN, next = FSI_UNKNOWN;
+
+    dm->m_fsidirty = 0;
+
+    b = fsinfo_buf(dm);
+    if (!b)
+        return;
+
+#if CONF_WITH_FAT_MAP
+    if (dm->m_fmap)
+    {
+        if (dm->m_fmap->fm_nfreeok)
+            free = dm->m_fmap->fm_nfree;
+        next = dm->m_fmap->fm_next;
+    }
+#endif
+
+    swpl(free);
+    swpl(next);
+    *(ULONG *)(b->b_bufr+FSI_OFF_FREE) = free;
+    *(ULONG *)(b->b_bufr+FSI_OFF_NEXT) = next;
+    b->b_dirty = 1;
+}
+#endif
+
+#if CONF_WITH_FAT_MAP
+#define ISFULL(fm,grp)  ((fm)->fm_full[(grp)>>3] & (1 << ((grp)&7)))
+#define SETFULL(fm,grp) ((fm)->fm_full[(grp)>>3] |= (1 << ((grp)&7)))
+#define CLRFULL(fm,grp) ((fm)->fm_full[(grp)>>3] &= ~(1 << ((grp)&7)))
+
+/*
+ * fatgroup - return the number of the map group containing (the start
+ * of) the FAT entry for cluster 'cl'
+ */
+static WORD fatgroup(LONG cl, DMD *dm, FATMAP *fm)
+{
+    return (fatoffset(cl,dm) >> dm->m_rblog) >> fm->fm_shift;
+}
+
+/*
+ * grpstart - return the first (valid) cluster number whose FAT entry
+ * starts in the specified map group
+ */
+static LONG grpstart(WORD grp, DMD *dm, FATMAP *fm)
+{
+    LONG offset, cl;
+
+    offset = ((LONG)grp << fm->fm_shift) << dm->m_rblog;
+#if CONF_WITH_FAT32
+    if (dm->m_32)
+        cl = offset >> 2;
+    else
+#endif
+    cl = dm->m_16 ? offset >> 1 : (2*offset + 2) / 3;
+
+    return (cl < 2) ? 2 : cl;
+}
+
+/*
+ * get_fatmap - get the allocation map for a drive, creating an empty
+ * one if necessary
+ *
+ * returns NULL if there is no memory for it, which is not an error:
+ * the map is only used to speed up findfree()
+ */
+static FATMAP *get_fatmap(DMD *dm)
+{
+    FATMAP *fm = dm->m_fmap;
+
+    if (!fm)
+    {
+        fm = MGET(FATMAP);      /* MGET() zeroes the block */
+        if (!fm)
+            return NULL;
+        while (((dm->m_fsiz-1) >> fm->fm_shift) >= FATMAP_BITS)
+            fm->fm_shift++;
+        fm->fm_next = 2;
+        dm->m_fmap = fm;
+#if CONF_WITH_FAT32
+        fsinfo_get(dm,NULL,&fm->fm_next);   /* use the hint, if any */
+#endif
+    }
+
+    return fm;
+}
+
+/*
+ * update_nfree - maintain the free cluster count when the FAT entry
+ * for a cluster changes from 'old' to 'new'
+ */
+static void update_nfree(FATMAP *fm, CLNO old, CLNO new)
+{
+    if (old && !new)
+        fm->fm_nfree++;
+    else if (!old && new)
+        fm->fm_nfree--;
+}
+#endif
 
 /*
 **  cl2rec -
@@ -37,20 +233,58 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
     CLNO f, mask;
     LONG offset, recnum;
     UBYTE *buf;
+#if CONF_WITH_FAT_MAP
+    FATMAP *fm = dm->m_fmap;
+    CLNO old;
 
-    offset = dm->m_16 ? (LONG)cl << 1 : ((LONG)cl + (cl >> 1));
+    /* the group containing a freed cluster is no longer full */
+    if (fm && (link == FREECLUSTER))
+        CLRFULL(fm,fatgroup(cl,dm,fm));
+#endif
+
+    offset = fatoffset(cl,dm);
     recnum = offset >> dm->m_rblog;
     offset &= dm->m_rbm;
 
+#if CONF_WITH_FAT32
+    /*
+     * handle 32-bit FAT
+     * the high 4 bits of the entry are reserved and must be preserved
+     */
+    if (dm->m_32)
+    {
+        buf = getrec(recnum,dm->m_fatofd,1);
+        f = *(ULONG *)(buf+offset);
+        swpl(f);
+#if CONF_WITH_FAT_MAP
+        old = f & 0x0fffffffL;
+        if (fm && fm->fm_nfreeok)
+            update_nfree(fm,old,link);
+#endif
+        f = (f & 0xf0000000L) | (link & 0x0fffffffL);
+        swpl(f);
+        *(ULONG *)(buf+offset) = f;
+        dm->m_fsidirty = 1;
+        return;
+    }
+#endif
+
     /*
      * handle 16-bit FAT
      * easier because content is word-aligned and cannot span FAT sectors
      */
     if (dm->m_16)
     {
+        UWORD w = link;
+
         buf = getrec(recnum,dm->m_fatofd,1);
-        swpw(link);
-        *(CLNO *)(buf+offset) = link;
+#if CONF_WITH_FAT_MAP
+        old = *(UWORD *)(buf+offset);   /* no need to swap to test for zero */
+        if (fm && fm->fm_nfreeok)
+            update_nfree(fm,old,link);
+#endif
+        swpw(w);
+        *(UWORD *)(buf+offset) = w;
         return;
     }
 
@@ -79,6 +313,11 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
 
     /* update */
     swpw(f);
+#if CONF_WITH_FAT_MAP
+    old = IS_ODD(cl) ? (f >> 4) : (f & 0x0fff);
+    if (fm && fm->fm_nfreeok)
+        update_nfree(fm,old,link);
+#endif
     f = (f & mask) | link;
     swpw(f);
 
@@ -91,14 +330,139 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
 }
 
 
+/*
+ * fatptr - return a pointer to the byte at 'offset' within the FAT, for
+ * updating.  the record containing it is only obtained via getrec() if
+ * it differs from the one used last time, which is remembered in
+ * '*prec' and '*pbuf'.
+ */
+static UBYTE *fatptr(LONG offset, DMD *dm, LONG *prec, UBYTE **pbuf)
+{
+    LONG recnum = offset >> dm->m_rblog;
+
+    if (recnum != *prec)
+    {
+        *pbuf = getrec(recnum,dm->m_fatofd,1);
+        *prec = recnum;
+#if CONF_WITH_FAT_MAP
+        /* the group containing a freed cluster is no longer full */
+        if (dm->m_fmap)
+            CLRFULL(dm->m_fmap,recnum >> dm->m_fmap->fm_shift);
+#endif
+    }
+
+    return *pbuf + (offset & dm->m_rbm);
+}
+
+
+/*
+ * freechain - free the chain of clusters starting at 'cl'
+ *
+ * this has the same effect as calling clfix(cl,FREECLUSTER,dm) for each
+ * cluster in turn, but the entries are read and cleared in place, so a
+ * FAT record is only fetched again when the chain leaves it.  the free
+ * cluster count is updated once, at the end.
+ *
+ * the chain ends at the first entry that is not a valid cluster number
+ * (free, reserved, bad or end-of-chain); the number of clusters freed is
+ * limited to the size of the disk, in case the chain loops.
+ */
+void freechain(CLNO cl, DMD *dm)
+{
+    CLNO next, count, limit, maxcl = dm->m_numcl + 1;
+    LONG offset, rec = -1L;
+    UBYTE *buf = NULL, *p;
+
+    for (count = 0, limit = dm->m_numcl; (cl >= 2) && (cl <= maxcl) && limit; limit--, cl = next)
+    {
+        offset = fatoffset(cl,dm);
+
+#if CONF_WITH_FAT32
+        /*
+         * handle 32-bit FAT
+         * the high 4 bits of the entry (in the last byte) are reserved
+         */
+        if (dm->m_32)
+        {
+            p = fatptr(offset,dm,&rec,&buf);
+            next = *(ULONG *)p;
+            swpl(next);
+            next &= 0x0fffffffL;
+            p[0] = p[1] = p[2] = 0;
+            p[3] &= 0xf0;
+        }
+        else
+#endif
+        /*
+         * handle 16-bit FAT
+         */
+        if (dm->m_16)
+        {
+            UWORD w;
+
+            p = fatptr(offset,dm,&rec,&buf);
+            w = *(UWORD *)p;
+            swpw(w);
+            next = w;
+            *(UWORD *)p = 0;
+        }
+        /*
+         * handle 12-bit FAT: the entry may span FAT records, so each
+         * of its bytes is handled separately
+         */
+        else
+        {
+            p = fatptr(offset,dm,&rec,&buf);
+            if (IS_ODD(cl))
+            {
+                next = *p >> 4;
+                *p &= 0x0f;
+            }
+            else
+            {
+                next = *p;
+                *p = 0;
+            }
+
+            p = fatptr(offset+1,dm,&rec,&buf);
+            if (IS_ODD(cl))
+            {
+                next |= (CLNO)*p << 4;
+                *p = 0;
+            }
+            else
+            {
+                next |= (CLNO)(*p & 0x0f) << 8;
+                *p &= 0xf0;
+            }
+        }
+
+        if (next != FREECLUSTER)
+            count++;
+    }
+
+#if CONF_WITH_FAT_MAP
+    if (dm->m_fmap && dm->m_fmap->fm_nfreeok)
+        dm->m_fmap->fm_nfree += count;
+#endif
+#if CONF_WITH_FAT32
+    if (dm->m_32 && count)
+        dm->m_fsidirty = 1;
+#endif
+}
+
+
 /*
 **  getrealcl -
 **      get the contents of the fat entry indexed by 'cl'.
 **
-**  returns 16-bit value
-**      for FAT12: 0xffff if entry contains the end of file marker
+**  returns
+**      for FAT12: ENDOFCHAIN if entry contains the end of file marker
 **                 otherwise, the contents of the entry
-**      for FAT16: the contents of the entry
+**      for FAT16: the contents of the entry (or ENDOFCHAIN, for FAT32
+**                 builds)
+**      for FAT32: the contents of the entry, excluding the reserved high
+**                 4 bits (or ENDOFCHAIN)
 **
 **      M01.0.1.03
 */
@@ -108,20 +472,40 @@ CLNO getrealcl(CLNO cl, DMD *dm)
     LONG offset, recnum;
     UBYTE *buf;
 
-    offset = dm->m_16 ? (LONG)cl << 1 : ((LONG)cl + (cl >> 1));
+    offset = fatoffset(cl,dm);
     recnum = offset >> dm->m_rblog;
     offset &= dm->m_rbm;
     buf = getrec(recnum,dm->m_fatofd,0) + offset;
 
+#if CONF_WITH_FAT32
+    /*
+     * handle 32-bit FAT
+     */
+    if (dm->m_32)
+    {
+        f = *(ULONG *)buf;
+        swpl(f);
+        f &= 0x0fffffffL;
+        if (endofchain(f))
+            f = ENDOFCHAIN;
+        return f;
+    }
+#endif
+
     /*
      * handle 16-bit FAT
      * easier because content is word-aligned and cannot span FAT sectors
      */
     if (dm->m_16)
     {
-        f = *(CLNO *)buf;
-        swpw(f);
-        return f;
+        UWORD w = *(UWORD *)buf;
+
+        swpw(w);
+#if CONF_WITH_FAT32
+        if ((w&0xfff8) == 0xfff8)   /* handle end of chain */
+            return ENDOFCHAIN;
+#endif
+        return w;
     }
 
     /*
@@ -164,6 +548,55 @@ CLNO getclnum(CLNO cl, OFD *of)
 }
 
 
+/*
+ * getfcbcl - get the starting cluster number from a directory entry
+ *
+ * the high word is only valid on FAT32 filesystems
+ */
+CLNO getfcbcl(const FCB *f, const DMD *dm)
+{
+    CLNO cl;
+    UWORD w;
+
+    w = f->f_clust;
+    swpw(w);
+    cl = w;
+
+#if CONF_WITH_FAT32
+    if (dm->m_32)
+    {
+        w = f->f_clusthi;
+        swpw(w);
+        cl |= (CLNO)w << 16;
+    }
+#endif
+
+    return cl;
+}
+
+
+/*
+ * setfcbcl - set the starting cluster number in a directory entry
+ */
+void setfcbcl(FCB *f, CLNO cl, const DMD *dm)
+{
+    UWORD w;
+
+    w = cl;
+    swpw(w);
+    f->f_clust = w;
+
+#if CONF_WITH_FAT32
+    if (dm->m_32)
+    {
+        w = cl >> 16;
+        swpw(w);
+        f->f_clusthi = w;
+    }
+#endif
+}
+
+
 /*
  * findfree16 - fast scan of FAT16 filesystem to find first free cluster
  *
@@ -180,16 +613,16 @@ static CLNO findfree16(DMD *dm)
         /*
          * get the next FAT record
          */
-        recnum = (clnum * sizeof(CLNO)) >> dm->m_rblog;
-        offset = (clnum * sizeof(CLNO)) & dm->m_rbm;
+        recnum = (clnum * sizeof(UWORD)) >> dm->m_rblog;
+        offset = (clnum * sizeof(UWORD)) & dm->m_rbm;
         buf = getrec(recnum, dm->m_fatofd, 0);
 
         /*
          * scan the FAT record, looking for a free slot
          */
-        for ( ; (offset < dm->m_recsiz) && (clnum < (dm->m_numcl+2)); offset += sizeof(CLNO), clnum++)
+        for ( ; (offset < dm->m_recsiz) && (clnum < (dm->m_numcl+2)); offset += sizeof(UWORD), clnum++)
         {
-            if (*(CLNO *)(buf+offset) == 0)
+            if (*(UWORD *)(buf+offset) == 0)
                 return clnum;
         }
     }
@@ -203,6 +636,99 @@ static CLNO findfree16(DMD *dm)
  *
  * returns cluster number, or 0 if no free clusters
  */
+#if CONF_WITH_FAT_MAP
+static CLNO findfree(CLNO start, DMD *dm)
+{
+    FATMAP *fm;
+    LONG cl, n, maxcl, from, next;
+    WORD grp, curgrp;
+    BOOL skipped = FALSE;
+
+    fm = get_fatmap(dm);
+
+    /*
+     * without a map, use the fast scan for the first free cluster
+     * on a FAT16 filesystem
+     */
+    if (!fm && (start == 0) && dm->m_16)
+        return findfree16(dm);
+
+    /*
+     * a new chain starts at the next-fit cursor, an existing one is
+     * extended from its current cluster
+     */
+    maxcl = (LONG)dm->m_numcl + 1;  /* highest cluster number */
+    cl = start;
+    if (cl < 2)
+        cl = fm ? fm->fm_next : 2;
+    if ((cl < 2) || (cl > maxcl))
+        cl = 2;
+
+    curgrp = -1;
+    grp = 0;
+    from = 0;
+
+    for (n = 0; n < dm->m_numcl; )  /* look at every cluster once */
+    {
+        if (fm)
+        {
+            grp = fatgroup(cl,dm,fm);
+            if (grp != curgrp)      /* entering a new group */
+            {
+                if (ISFULL(fm,grp)) /* nothing free here, skip it */
+                {
+                    skipped = TRUE;
+                    next = grpstart(grp+1,dm,fm);
+                    if (next > maxcl)
+                    {
+                        n += maxcl + 1 - cl;
+                        cl = 2;     /* wrap at max cluster num */
+                    }
+                    else
+                    {
+                        n += next - cl;
+                        cl = next;
+                    }
+                    continue;
+                }
+                curgrp = grp;
+                from = cl;          /* first cluster checked in group */
+            }
+        }
+
+        if (!getrealcl(cl,dm))      /* check for empty cluster */
+        {
+            if (fm)
+                fm->fm_next = (cl < maxcl) ? cl+1 : 2;
+            return cl;
+        }
+
+        /*
+         * if we have now checked all the clusters in the group,
+         * remember that it's full
+         */
+        if (fm && (from == grpstart(grp,dm,fm))
+         && ((cl == maxcl) || (fatgroup(cl+1,dm,fm) != grp)))
+            SETFULL(fm,grp);
+
+        n++;
+        if (++cl > maxcl)           /* wrap at max cluster num */
+            cl = 2;
+    }
+
+    /*
+     * the map may be out of date if the FAT has been changed behind
+     * our back (e.g. via Rwabs()), so check again without it
+     */
+    if (skipped)
+    {
+        bzero(fm->fm_full,FATMAP_BYTES);
+        return findfree(start,dm);
+    }
+
+    return 0;
+}
+#else
 static CLNO findfree(CLNO cl, DMD *dm)
 {
     CLNO i;
@@ -230,6 +756,7 @@ static CLNO findfree(CLNO cl, DMD *dm)
 
     return 0;
 }
+#endif /* CONF_WITH_FAT_MAP */
 
 
 /*
@@ -291,6 +818,192 @@ int nextcl(OFD *p, int wrtflg)
 }
 
 
+#if CONF_WITH_PREALLOC
+/*
+ * when a write extends a file, prealloc() also allocates this many
+ * bytes beyond the end of the write, to leave room for growth
+ */
+#define PREALLOC_EXTRA  16384L
+
+/* max number of free runs examined when looking for a long enough one */
+#define PREALLOC_TRIES  4
+
+/*
+ * runlen - return the number of free clusters starting at 'cl',
+ * counting no further than 'max'
+ */
+static LONG runlen(CLNO cl, LONG max, DMD *dm)
+{
+    LONG n, maxcl = (LONG)dm->m_numcl + 1;
+
+    for (n = 0; (n < max) && (cl + n <= maxcl); n++)
+        if (getrealcl(cl+n,dm))
+            break;
+
+    return n;
+}
+
+
+/*
+ * prealloc - allocate clusters for a write of 'len' bytes at the
+ * current position, as a single contiguous run if possible
+ *
+ * the new clusters are added to the end of the chain.  if no run is
+ * long enough, the longest one found is used, and nextcl() allocates
+ * the remainder as usual.  running out of space is not an error here:
+ * the write will report it.
+ */
+void prealloc(OFD *p, long len)
+{
+    DMD *dm = p->o_dmd;
+    DFD *dfd = p->o_dfd;
+    CLNO cl, last, next, start, best;
+    LONG have, need, want, n, bestlen, limit;
+    int i;
+
+    /*
+     * find the end of the chain, starting from the current cluster
+     * if possible, and count its clusters
+     */
+    if (p->o_curcl && p->o_bytnum)
+    {
+        last = p->o_curcl;
+        have = ((p->o_bytnum - 1) >> dm->m_clblog) + 1;
+    }
+    else
+    {
+        last = dfd->o_strtcl;
+        have = last ? 1 : 0;
+    }
+
+    need = (p->o_bytnum + len + dm->m_clsizb - 1) >> dm->m_clblog;
+    if (need <= have)
+        return;
+
+    limit = dm->m_numcl;        /* guard against a looping chain */
+    while (last && (limit-- > 0))
+    {
+        next = getrealcl(last,dm);
+        if (endofchain(next) || (next < 2))
+            break;
+        last = next;
+        if (++have >= need)
+            return;
+    }
+
+    /*
+     * look for a run of free clusters long enough for the write plus
+     * the growth hint, remembering the longest one found
+     */
+    want = need - have + (PREALLOC_EXTRA >> dm->m_clblog);
+    best = 0;
+    bestlen = 0;
+    for (i = 0, start = last; i < PREALLOC_TRIES; i++)
+    {
+        start = findfree(start,dm);
+        if (!start)
+            break;
+        n = runlen(start,want,dm);
+        if (n > bestlen)
+        {
+            best = start;
+            bestlen = n;
+        }
+        if (n >= want)
+            break;
+        start += n;
+    }
+
+    if (!best)
+        return;
+
+    /*
+     * link the run into the chain
+     */
+    for (cl = best, n = 1; n < bestlen; cl++, n++)
+        clfix(cl,cl+1,dm);
+    clfix(cl,ENDOFCHAIN,dm);
+
+    if (last)
+        clfix(last,best,dm);
+    else
+    {
+        dfd->o_strtcl = best;
+        dfd->o_flag |= O_DIRTY;
+    }
+    dfd->o_flag |= O_PREALLOC;
+
+#if CONF_WITH_FAT_MAP
+    if (dm->m_fmap)
+        dm->m_fmap->fm_next = (cl < dm->m_numcl+1) ? cl+1 : 2;
+#endif
+}
+
+
+/*
+ * trimchain - free any clusters beyond the end of the file
+ */
+void trimchain(OFD *p)
+{
+    DMD *dm = p->o_dmd;
+    DFD *dfd = p->o_dfd;
+    CLNO cl, next;
+    LONG keep, idx;
+
+    dfd->o_flag &= ~O_PREALLOC;
+
+    keep = (dfd->o_fileln + dm->m_clsizb - 1) >> dm->m_clblog;
+
+    /*
+     * find the last cluster to keep, starting from the current
+     * cluster if we are not beyond it yet (the usual case)
+     */
+    if (keep == 0)
+    {
+        cl = dfd->o_strtcl;
+        if (!cl)
+            return;
+        dfd->o_strtcl = 0;
+        dfd->o_flag |= O_DIRTY;
+    }
+    else
+    {
+        idx = 0;
+        cl = dfd->o_strtcl;
+        if (p->o_curcl && p->o_bytnum
+         && ((p->o_bytnum - 1) >> dm->m_clblog) < keep)
+        {
+            idx = (p->o_bytnum - 1) >> dm->m_clblog;
+            cl = p->o_curcl;
+        }
+
+        for ( ; idx < keep - 1; idx++)
+        {
+            cl = getrealcl(cl,dm);
+            if (endofchain(cl) || (cl < 2))
+                return;     /* chain is shorter than the file (!) */
+        }
+
+        next = getrealcl(cl,dm);
+        if (endofchain(next) || (next < 2))
+            return;         /* nothing to free */
+        clfix(cl,ENDOFCHAIN,dm);
+        cl = next;
+    }
+
+    /*
+     * free the rest of the chain, which may also be in the file's
+     * extent map
+     */
+    freechain(cl,dm);
+
+#if CONF_WITH_EXTENT_MAP
+    xmap_free(dfd);
+#endif
+}
+#endif /* CONF_WITH_PREALLOC */
+
+
 /*
  * countfree16 - fast scan of FAT16 filesystem to count free clusters
  */
@@ -305,16 +1018,16 @@ static CLNO countfree16(DMD *dm)
         /*
          * get the next FAT record
          */
-        recnum = (clnum * sizeof(CLNO)) >> dm->m_rblog;
-        offset = (clnum * sizeof(CLNO)) & dm->m_rbm;
+        recnum = (clnum * sizeof(UWORD)) >> dm->m_rblog;
+        offset = (clnum * sizeof(UWORD)) & dm->m_rbm;
         buf = getrec(recnum, dm->m_fatofd, 0);
 
         /*
          * scan the FAT record, counting free slots
          */
-        for ( ; (offset < dm->m_recsiz) && (clnum < (dm->m_numcl+2)); offset += sizeof(CLNO), clnum++)
+        for ( ; (offset < dm->m_recsiz) && (clnum < (dm->m_numcl+2)); offset += sizeof(UWORD), clnum++)
         {
-            if (*(CLNO *)(buf+offset) == 0)
+            if (*(UWORD *)(buf+offset) == 0)
                 free++;
         }
     }
@@ -323,6 +1036,50 @@ static CLNO countfree16(DMD *dm)
 }
 
 
+#if CONF_WITH_FAT32
+/*
+ * countfree32 - count free clusters on a FAT32 filesystem
+ *
+ * the count in the FSInfo sector is used if it is plausible, since
+ * scanning a large FAT takes a long time
+ */
+static CLNO countfree32(DMD *dm)
+{
+    LONG recnum;
+    int offset;
+    CLNO free, clnum;
+    UBYTE *buf;
+
+    free = FSI_UNKNOWN;
+    fsinfo_get(dm,&free,NULL);
+    if (free != FSI_UNKNOWN)
+        return free;
+
+    for (clnum = 2, free = 0; clnum < dm->m_numcl+2; )
+    {
+        /*
+         * get the next FAT record
+         */
+        recnum = (clnum * sizeof(ULONG)) >> dm->m_rblog;
+        offset = (clnum * sizeof(ULONG)) & dm->m_rbm;
+        buf = getrec(recnum, dm->m_fatofd, 0);
+
+        /*
+         * scan the FAT record, counting free slots (the high 4 bits
+         * are reserved)
+         */
+        for ( ; (offset < dm->m_recsiz) && (clnum < (dm->m_numcl+2)); offset += sizeof(ULONG), clnum++)
+        {
+            if ((*(ULONG *)(buf+offset) & 0xffffff0fL) == 0)
+                free++;
+        }
+    }
+
+    return free;
+}
+#endif
+
+
 /*      Function 0x36   d_free
                 get disk free space data into buffer *
         Error returns
@@ -330,13 +1087,20 @@ static CLNO countfree16(DMD *dm)
 
         The code is optimised for 16-bit FATs.  The 12-bit case is more
         complex, since the entry for a cluster can span logical records,
-        and therefore we do it the old, slow way.
+        and therefore we do it the old, slow way.  For 32-bit FATs, the
+        count in the FSInfo sector is used if possible.
+
+        If there is an allocation map for the drive, the count is only
+        done once, and then maintained by clfix().
 */
 long xgetfree(long *buf, int drv)
 {
     CLNO i, free;
     WORD n;
     DMD *dm;
+#if CONF_WITH_FAT_MAP
+    FATMAP *fm;
+#endif
 
     drv = (drv ? drv-1 : run->p_curdrv);
 
@@ -344,6 +1108,26 @@ long xgetfree(long *buf, int drv)
         return ERR;
 
     dm = drvtbl[n];
+
+#if CONF_WITH_BDOS_CACHE
+    bufl_flush(n);      /* make sure the disk is up to date */
+#endif
+
+#if CONF_WITH_FAT_MAP
+    fm = get_fatmap(dm);
+    if (fm && fm->fm_nfreeok)
+    {
+        free = fm->fm_nfree;
+    }
+    else
+#endif
+#if CONF_WITH_FAT32
+    if (dm->m_32)
+    {
+        free = countfree32(dm);
+    }
+    else
+#endif
     if (dm->m_16)
     {
         free = countfree16(dm);
@@ -356,6 +1140,14 @@ long xgetfree(long *buf, int drv)
                 free++;
     }
 
+#if CONF_WITH_FAT_MAP
+    if (fm)
+    {
+        fm->fm_nfree = free;
+        fm->fm_nfreeok = TRUE;
+    }
+#endif
+
     *buf++ = (long)(free);
     *buf++ = (long)(dm->m_numcl);
     *buf++ = (long)(dm->m_recsiz);
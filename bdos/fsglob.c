@@ -41,6 +41,13 @@ long rwerr;
 long errcode;
 
 
+/*
+ * rwabs_calls -  number of Rwabs() calls made by the file system
+ *                (not counting writes done in the background)
+ */
+ULONG rwabs_calls;
+
+
 /*
  * errdrv -  drive on which error occurred
  */
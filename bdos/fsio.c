@@ -10,6 +10,7 @@
 
 #include "emutos.h"
 #include "fs.h"
+#include "mem.h"
 #include "gemerror.h"
 #include "biosbind.h"
 #include "string.h"
@@ -45,6 +46,132 @@ static void addit(OFD *p, long siz)
 }
 
 
+#if CONF_WITH_EXTENT_MAP
+/*
+ * xmap_find - look up a cluster in the extent map
+ *
+ * 'idx' is the number of the cluster within the file (counting from 0).
+ * returns the cluster number on disk, or 0 if it is not mapped yet
+ */
+static CLNO xmap_find(XMAP *xm, LONG idx)
+{
+    WORD lo, hi, mid;
+
+    if ((idx < 0) || (idx >= xm->x_fcl[xm->x_count]))
+        return 0;
+
+    /* find the last extent that starts at or before idx */
+    lo = 0;
+    hi = xm->x_count - 1;
+    while (lo < hi)
+    {
+        mid = (lo + hi + 1) / 2;
+        if (xm->x_fcl[mid] <= idx)
+            lo = mid;
+        else hi = mid - 1;
+    }
+
+    return xm->x_dcl[lo] + (idx - xm->x_fcl[lo]);
+}
+
+
+/*
+ * xmap_add - record that cluster 'idx' of the file is disk cluster 'cl'
+ *
+ * since the map always describes the start of the chain, this only
+ * does anything if idx is the first cluster that is not yet mapped.
+ * once all the extents are in use, the map stops growing, and clusters
+ * beyond it are found by following the chain as usual.
+ */
+static void xmap_add(XMAP *xm, LONG idx, CLNO cl)
+{
+    WORD n = xm->x_count;
+
+    if ((idx < 0) || (idx != xm->x_fcl[n]))
+        return;
+
+    if (n && (cl == xm->x_dcl[n-1] + (idx - xm->x_fcl[n-1])))
+    {
+        xm->x_fcl[n]++;             /* extends the last extent */
+        return;
+    }
+
+    if (n >= XMAP_EXTENTS)
+        return;
+
+    xm->x_dcl[n] = cl;
+    xm->x_count = ++n;
+    xm->x_fcl[n] = idx + 1;
+}
+
+
+/*
+ * xmap_free - discard the extent map (if any) for a file
+ *
+ * this must be called when the file's chain is freed, and before the
+ * base OFD is freed
+ */
+void xmap_free(DFD *dfd)
+{
+    if (dfd->o_xmap)
+    {
+        xmfreblk(dfd->o_xmap);
+        dfd->o_xmap = NULL;
+    }
+}
+
+
+/*
+ * nextidx - get the number within the file of the cluster that
+ * nextcl() would move to, or -1 if this cannot be determined
+ */
+static LONG nextidx(OFD *p)
+{
+    if (!p->o_curcl)
+        return 0;
+    if (!p->o_bytnum)
+        return -1;
+
+    return ((p->o_bytnum - 1) >> p->o_dmd->m_clblog) + 1;
+}
+
+
+/*
+ * xmap_nextcl - like nextcl(), but uses the extent map if there is one
+ *
+ * 'idx' is the value returned by nextidx() before any clusters were
+ * chained to by the caller, plus the number of clusters chained to
+ * since then.
+ */
+static int xmap_nextcl(OFD *p, int wrtflg, LONG idx)
+{
+    XMAP *xm = p->o_dfd->o_xmap;
+    CLNO cl;
+    int rc;
+
+    if (!xm)
+        return nextcl(p,wrtflg);
+
+    cl = xmap_find(xm,idx);
+    if (cl)
+    {
+        p->o_curcl = cl;
+        p->o_currec = cl2rec(cl,p->o_dmd);
+        p->o_curbyt = 0;
+        return E_OK;
+    }
+
+    rc = nextcl(p,wrtflg);
+    if (rc == E_OK)
+        xmap_add(xm,idx,p->o_curcl);
+
+    return rc;
+}
+#else
+#define xmap_nextcl(p,wrtflg,idx)   nextcl(p,wrtflg)
+#endif
+
+
 /*
  * usrio - interface to rwabs
  *
@@ -55,6 +182,23 @@ static void addit(OFD *p, long siz)
 static void usrio(int rwflg, int num, long strt, char *ubuf, DMD *dm)
 {
     BCB *b;
+#if CONF_WITH_READAHEAD
+    WORD n;
+
+    /*
+     * when reading, use any records at the start that are already in
+     * the cache (typically because they were read ahead)
+     */
+    if (!rwflg)
+    {
+        n = bufl_read(dm,strt,num,(UBYTE *)ubuf);
+        if (n == num)
+            return;
+        num -= n;
+        strt += n;
+        ubuf += (long)n << dm->m_rblog;
+    }
+#endif
 
     for (b = bufl[BI_DATA]; b; b = b->b_link)
     {
@@ -72,6 +216,118 @@ static void usrio(int rwflg, int num, long strt, char *ubuf, DMD *dm)
 }
 
 
+#if CONF_WITH_READAHEAD
+/*
+ * read-ahead state for the files that were read most recently.  a file
+ * is being read sequentially if each read starts where the previous one
+ * ended.  the window doubles after each read-ahead, unless some records
+ * that were read ahead have been discarded unused in the meantime, in
+ * which case it is halved.
+ */
+#define RA_STREAMS  4
+#define RA_MIN      2           /* initial window, in records */
+#define RA_MAX      32          /* largest window, in records */
+
+typedef struct
+{
+    OFD   *ra_ofd;      /* file, or NULL */
+    LONG  ra_next;      /* position where the next read should start */
+    ULONG ra_waste;     /* bcstat.bc_rawaste at last read-ahead */
+    WORD  ra_window;    /* current window, in records */
+} RASTATE;
+
+static RASTATE rastate[RA_STREAMS];
+static WORD ra_rover;
+
+/*
+ * readahead - called after a read of 'len' bytes starting at 'start'
+ */
+static void readahead(OFD *p, LONG start, LONG len)
+{
+    RASTATE *ra;
+    DMD *dm = p->o_dmd;
+    CLNO cl, nxt;
+    RECNO rec;
+    LONG left, n;
+    WORD i, lim;
+
+    for (i = 0, ra = rastate; i < RA_STREAMS; i++, ra++)
+        if (ra->ra_ofd == p)
+            break;
+
+    if (i >= RA_STREAMS)        /* new file: remember it, do nothing yet */
+    {
+        ra = &rastate[ra_rover];
+        ra_rover = (ra_rover + 1) % RA_STREAMS;
+        ra->ra_ofd = p;
+        ra->ra_next = p->o_bytnum;
+        ra->ra_waste = bcstat.bc_rawaste;
+        ra->ra_window = RA_MIN;
+        return;
+    }
+
+    if (start != ra->ra_next)   /* not sequential */
+    {
+        ra->ra_next = p->o_bytnum;
+        ra->ra_window = RA_MIN;
+        return;
+    }
+    ra->ra_next = p->o_bytnum;
+
+    /*
+     * reads of whole clusters are done directly, so don't bother.  we
+     * also need a current cluster, and something left to read.
+     */
+    left = p->o_dfd->o_fileln - p->o_bytnum;
+    if ((len >= dm->m_clsizb) || !p->o_curcl || (left <= 0))
+        return;
+
+    /* adapt the window */
+    lim = min(RA_MAX, bcstat.bc_ndata / 2);
+    if (bcstat.bc_rawaste != ra->ra_waste)
+        ra->ra_window = max(RA_MIN, ra->ra_window / 2);
+    else if (ra->ra_window < lim)
+        ra->ra_window *= 2;
+    if (ra->ra_window > lim)
+        ra->ra_window = lim;
+
+    /*
+     * find the first record not yet read: if we're at the end of the
+     * current cluster, it's at the start of the next one
+     */
+    cl = p->o_curcl;
+    i = p->o_curbyt >> dm->m_rblog;
+    if ((i >= dm->m_clsiz) || (p->o_curbyt == 0))
+    {
+        cl = getrealcl(cl,dm);
+        if (endofchain(cl) || (cl < 2))
+            return;
+        i = 0;
+    }
+    rec = cl2rec(cl,dm) + i;
+
+    /*
+     * extend that through following clusters as long as they are
+     * contiguous, up to the window size or the end of file
+     */
+    n = (left + (p->o_curbyt & dm->m_rbm) + dm->m_recsiz - 1) >> dm->m_rblog;
+    if (n > ra->ra_window)
+        n = ra->ra_window;
+    for (lim = dm->m_clsiz - i; lim < n; lim += dm->m_clsiz, cl = nxt)
+    {
+        nxt = getrealcl(cl,dm);
+        if (nxt != cl + 1)
+            break;
+    }
+    if (n > lim)
+        n = lim;
+
+    bufl_readahead(dm,rec,n);
+    ra->ra_waste = bcstat.bc_rawaste;
+}
+#endif
+
+
 /*
  * read/write records on behalf of xrw()
  *
@@ -87,6 +343,9 @@ static char *xrw_recs(WORD wrtflg, OFD *p, RECNO startrec, RECNO numrecs, char *
     LONG nbytes;
     WORD rc;
     BOOL first_time;
+#if CONF_WITH_EXTENT_MAP
+    LONG idx;
+#endif
 
     dm = p->o_dmd;
 
@@ -117,6 +376,10 @@ static char *xrw_recs(WORD wrtflg, OFD *p, RECNO startrec, RECNO numrecs, char *
     /* now we can calculate the number of 'tail' records */
     tailrec = numrecs & dm->m_clrm;
 
+#if CONF_WITH_EXTENT_MAP
+    idx = nextidx(p);
+#endif
+
     /*
      * do whole (middle) clusters
      */
@@ -128,7 +391,13 @@ static char *xrw_recs(WORD wrtflg, OFD *p, RECNO startrec, RECNO numrecs, char *
     while(TRUE)
     {
         if (numclus)
-            rc = nextcl(p,wrtflg);
+        {
+            rc = xmap_nextcl(p,wrtflg,idx);
+#if CONF_WITH_EXTENT_MAP
+            if (idx >= 0)
+                idx++;
+#endif
+        }
 
         if (first_time)
         {
@@ -171,7 +440,7 @@ static char *xrw_recs(WORD wrtflg, OFD *p, RECNO startrec, RECNO numrecs, char *
      */
     if (tailrec)
     {
-        if (nextcl(p,wrtflg))
+        if (xmap_nextcl(p,wrtflg,idx))
             return NULL;
         KDEBUG(("xrw(%c %d): xfer tail recs %ld->%ld\n",
                 wrtflg?'W':'R',dm->m_drvnum,p->o_currec,p->o_currec+tailrec-1));
@@ -262,7 +531,7 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
 
         if ((!recn) || (recn == (RECNO)dm->m_clsiz))
         {
-            if (nextcl(p,wrtflg))
+            if (xmap_nextcl(p,wrtflg,nextidx(p)))
                 goto eof;
             recn = 0;
         }
@@ -278,6 +547,11 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
 eof:
     rc = p->o_bytnum - bytpos;
 
+#if CONF_WITH_READAHEAD
+    if (!wrtflg && p->o_dnode)
+        readahead(p,bytpos,rc);
+#endif
+
     return(rc);
 }
 
@@ -331,6 +605,17 @@ long xlseek(long n, int h, int flg)
     else if (flg)
         return(EINVFN);
 
+#if CONF_WITH_EXTENT_MAP
+    /*
+     * seeking backwards means following the cluster chain from the
+     * start of the file, so this is where an extent map pays off:
+     * create one if we don't have it yet.  if there is no memory for
+     * it, we just carry on without.
+     */
+    if ((n < f->o_bytnum) && !f->o_dfd->o_xmap)
+        f->o_dfd->o_xmap = MGET(XMAP);
+#endif
+
     return(ixlseek(f,n));
 }
 
@@ -351,9 +636,13 @@ long xlseek(long n, int h, int flg)
 
 long ixlseek(OFD *p,long n)
 {
-    CLNO clnum, clx, curnum, i;
+    CLNO clnum, clx, curnum;
     DMD *dm = p->o_dmd;
     DFD *dfd = p->o_dfd;
+#if CONF_WITH_EXTENT_MAP
+    XMAP *xm = dfd->o_xmap;
+    CLNO mapped;
+#endif
 
     if ((n < 0) || (n > dfd->o_fileln))
         return ERANGE;
@@ -366,8 +655,19 @@ long ixlseek(OFD *p,long n)
 
     /*
      * calculate the desired position in units of 1 cluster
+     *
+     * note: if we're seeking to a position which is at a cluster boundary,
+     * we actually point to the cluster before that.  this nonobvious action
+     * is because, when the read point is at the start of a cluster, xrw()
+     * starts its processing by handling whole clusters.  this occurs in
+     * either the middle or tail section processing, but in both cases,
+     * xrw() always chains to the next cluster before doing the actual read.
+     *
+     * see the code in xrw() if you need to know more ...
      */
     clnum = n >> dm->m_clblog;
+    if ((n&dm->m_clbm) == 0)    /* go one less if on cluster boundary */
+        clnum--;
 
     /*
      * if that's beyond where we are, we can chain forward;
@@ -383,36 +683,53 @@ long ixlseek(OFD *p,long n)
         /*
          * if we're currently at the end of a cluster, we haven't yet read
          * in the cluster that really corresponds to our position, so we
-         * need to allow for that.  See the comments further below for why
-         * we also do this when we're at the beginning of a cluster ...
+         * need to allow for that.  See the comments above for why we also
+         * do this when we're at the beginning of a cluster ...
          */
         if (((p->o_curbyt == 0) || (p->o_curbyt == dm->m_clsizb)) && p->o_bytnum)
             curnum--;
 
-        clnum -= curnum;
         clx = p->o_curcl;
     }
     else            /* we have to start at the beginning */
+    {
+        curnum = 0;
         clx = dfd->o_strtcl;
+#if CONF_WITH_EXTENT_MAP
+        if (xm)
+            xmap_add(xm,0,clx);
+#endif
+    }
 
+#if CONF_WITH_EXTENT_MAP
     /*
-     * note: if we're seeking to a position which is at a cluster boundary,
-     * we actually point to the cluster before that.  this nonobvious action
-     * is because, when the read point is at the start of a cluster, xrw()
-     * starts its processing by handling whole clusters.  this occurs in
-     * either the middle or tail section processing, but in both cases,
-     * xrw() always chains to the next cluster before doing the actual read.
-     *
-     * see the code in xrw() if you need to know more ...
+     * use the extent map to skip as much of the chain as possible
      */
-    if ((n&dm->m_clbm) == 0)    /* go one less if on cluster boundary */
-        clnum--;
+    if (xm && xm->x_count)
+    {
+        mapped = xm->x_fcl[xm->x_count];
+        if (clnum < mapped)
+        {
+            curnum = clnum;
+            clx = xmap_find(xm,clnum);
+        }
+        else if (mapped - 1 > curnum)
+        {
+            curnum = mapped - 1;
+            clx = xmap_find(xm,curnum);
+        }
+    }
+#endif
 
-    for (i = 0; i < clnum; i++)
+    for ( ; curnum < clnum; curnum++)
     {
         clx = getclnum(clx,p);
         if (endofchain(clx))
             return EINTRN;      /* FAT chain is shorter than filesize says ... */
+#if CONF_WITH_EXTENT_MAP
+        if (xm)
+            xmap_add(xm,curnum+1,clx);
+#endif
     }
 
     p->o_curcl = clx;
@@ -534,7 +851,12 @@ long xwrite(int h, long len, void *ubufr)
      */
 
     if (p)
+    {
+#if CONF_WITH_PREALLOC
+        prealloc(p,len);
+#endif
         ret = ixwrite(p,len,ubufr);
+    }
     else
         ret = EIHNDL;
 
@@ -551,3 +873,106 @@ long ixwrite(OFD *p, long len, void *ubufr)
 {
     return(xrw(1,p,len,ubufr));
 }
+
+
+#if CONF_WITH_FCOPY
+#define FCOPY_MINBUF    4096L       /* smallest internal buffer */
+
+static jmp_buf fc_bakbuf;           /* longjmp buffer */
+static UBYTE *fc_buf;               /* static to avoid the obscure longjmp warning */
+
+/*
+ * xfcopy - copy 'len' bytes from handle 'src' to handle 'dst'
+ *
+ * Function 0x5A  Fcopy - EmuTOS extension
+ *
+ * This has the same effect as an Fread()/Fwrite() loop starting at the
+ * current position of each file, but the data does not pass through the
+ * caller's buffer.  The clusters for the destination are allocated in
+ * one go (as a single run, if possible), and the data is moved with
+ * multi-record transfers via an internal buffer of up to FCOPY_BUFSIZE
+ * bytes.
+ *
+ * Returns the number of bytes copied.  This is less than 'len' if the
+ * end of the source file was reached, or if the destination disk is full
+ * (in which case the source file is positioned after the last byte that
+ * was copied).
+ *
+ * Error returns
+ *   EIHNDL
+ *   EACCDN     source and destination are the same file
+ *   ENSMEM     not enough memory for the internal buffer
+ *   bios()
+ */
+long xfcopy(int src, int dst, long len)
+{
+    OFD *ps, *pd;
+    long bufsize, done, n, w;
+
+    ps = getofd(src);
+    pd = getofd(dst);
+    if (!ps || !pd)
+        return EIHNDL;
+    if (ps->o_dfd == pd->o_dfd)
+        return EACCDN;
+
+    n = ps->o_dfd->o_fileln - ps->o_bytnum;
+    if (len > n)
+        len = n;
+    if (len <= 0)
+        return 0L;
+
+    /*
+     * get the internal buffer: no bigger than necessary, and smaller
+     * if memory is short
+     */
+    for (bufsize = FCOPY_BUFSIZE; (bufsize > FCOPY_MINBUF) && (bufsize/2 >= len); bufsize /= 2)
+        ;
+    for ( ; ; bufsize /= 2)
+    {
+#if CONF_PREFER_STRAM_DISK_BUFFERS
+        fc_buf = xmxalloc(bufsize, MX_STRAM);
+#else
+        fc_buf = xmalloc(bufsize);
+#endif
+        if (fc_buf)
+            break;
+        if (bufsize <= FCOPY_MINBUF)
+            return ENSMEM;
+    }
+
+    /* we have now allocated memory, so we need to intercept longjmp */
+    memcpy(fc_bakbuf, errbuf, sizeof(errbuf));
+    if (setjmp(errbuf))
+    {
+        KDEBUG(("Error and longjmp in xfcopy()!\n"));
+        xmfree(fc_buf);
+        longjmp(fc_bakbuf, 1);
+    }
+
+#if CONF_WITH_PREALLOC
+    prealloc(pd,len);
+#endif
+
+    for (done = 0L; done < len; done += w)
+    {
+        n = ixread(ps, min(len-done,bufsize), fc_buf);
+        if (n <= 0)
+            break;
+        w = ixwrite(pd, n, fc_buf);
+        if (w < n)      /* disk full: don't skip what wasn't written */
+        {
+            done += w;
+            ixlseek(ps, ps->o_bytnum - (n - w));
+            break;
+        }
+    }
+
+    memcpy(errbuf, fc_bakbuf, sizeof(errbuf));
+    xmfree(fc_buf);
+
+    KDEBUG(("xfcopy(%d,%d,%ld): rc=%ld\n",src,dst,len,done));
+
+    return done;
+}
+#endif
@@ -49,6 +49,7 @@
 #include "gemerror.h"
 #include "string.h"
 #include "mem.h"
+#include "proc.h"
 #include "time.h"
 #include "console.h"
 #include "bdosstub.h"
@@ -102,6 +103,7 @@ long ixcreat(char *name, UBYTE attr)
     char n[2], a[FNAMELEN];                 /*  M01.01.03   */
     int i, f2;                              /*  M01.01.03   */
     long pos, rc;
+    BOOL hint;
 
     n[0] = ERASE_MARKER; n[1] = 0;
 
@@ -161,9 +163,13 @@ long ixcreat(char *name, UBYTE attr)
             return EACCDN;
     }
     else
-        pos = 0;
+        pos = dn->d_free;
 
-    /* now scan for empty space */
+    /*
+     * now scan for empty space, starting with the slot of the file
+     * we just deleted, or else the first slot that may be free
+     */
+    hint = (pos == dn->d_free);
 
     /*  M01.01.SCC.FS.02  */
     while( !( fcb = scan(dn,n,0xff,&pos) ) )
@@ -176,14 +182,15 @@ long ixcreat(char *name, UBYTE attr)
             return EACCDN;
 
         dirinit(dn);
-        pos = 0;
+        pos = dn->d_free;
     }
 
     builds(s,a);
     pos -= sizeof(FCB);
     fcb->f_attrib = attr;
-    for (i = 0; i < 10; i++)
+    for (i = 0; i < sizeof(fcb->f_fill); i++)
         fcb->f_fill[i] = 0;
+    fcb->f_clusthi = 0;
     fcb->f_td.time = current_time;
     swpw(fcb->f_td.time);
     fcb->f_td.date = current_date;
@@ -192,6 +199,11 @@ long ixcreat(char *name, UBYTE attr)
     fcb->f_fileln = 0;
     ixlseek(fd,pos);
     ixwrite(fd,FNAMELEN,a);         /* write name, set dirty flag */
+    if (hint)                       /* all slots up to here are in use */
+        dn->d_free = pos + sizeof(FCB);
+#if CONF_WITH_DIR_CACHE
+    dcache_drop(dn,a);              /* the name now exists */
+#endif
     ixclose(fd,CL_DIR);             /* partial close to flush */
     ixlseek(fd,pos);
     s = (char *)ixgetfcb(fd);
@@ -309,8 +321,7 @@ static long makopn(FCB *f, DND *dn, int h, int mod)
         dfd->o_usecnt = 1;              /* only OFD using this DFD */
         dfd->o_td.date = f->f_td.date;  /* note: OFD time/date are  */
         dfd->o_td.time = f->f_td.time;  /*  actually little-endian! */
-        dfd->o_strtcl = f->f_clust;     /* 1st cluster of file */
-        swpw(dfd->o_strtcl);
+        dfd->o_strtcl = getfcbcl(f,dm); /* 1st cluster of file */
         dfd->o_fileln = f->f_fileln;    /* init length of file */
         swpl(dfd->o_fileln);
     }
@@ -401,6 +412,9 @@ static void sftdel(FTAB *sftp)
 
         if (d->o_usecnt == 0)       /* no more users of this file */
         {
+#if CONF_WITH_EXTENT_MAP
+            xmap_free(d);
+#endif
             ofd = (OFD *)((char *)d - offsetof(OFD, o_disk));
             xmfreblk(ofd);          /* delete the 'base OFD' */
         }
@@ -508,10 +522,13 @@ long xclose(int h)
 long ixclose(OFD *fd, int part)
 {                                   /*  M01.01.03                   */
     OFD *p, **q;
-    int i;                          /*  M01.01.03                   */
-    BCB *b;
     DFD *dfd = fd->o_dfd;
 
+#if CONF_WITH_PREALLOC
+    if (!part && (dfd->o_flag & O_PREALLOC))
+        trimchain(fd);              /* free clusters beyond end of file */
+#endif
+
     /*
      * if the file or folder has been modified, we need to make sure
      * that the date/time, starting cluster, and file length in the
@@ -532,14 +549,20 @@ long ixclose(OFD *fd, int part)
         ixlseek(fd->o_dirfil,fd->o_dirbyt); /* start of dir entry */
         fcb = ixgetfcb(fd->o_dirfil);
         attr = fcb->f_attrib;               /* get attributes */
-        memcpy(&fcb->f_td,&dfd->o_td,10);   /* copy date/time, start, length */
-        swpw(fcb->f_clust);                 /*  & fixup byte order */
+        fcb->f_td = dfd->o_td;              /* copy date/time, start, length */
+        setfcbcl(fcb,dfd->o_strtcl,fd->o_dmd);  /*  & fixup byte order */
+        fcb->f_fileln = dfd->o_fileln;
         swpl(fcb->f_fileln);
 
         if (part & CL_DIR)
             fcb->f_fileln = 0L;             /* dir lengths on disk are zero */
         else
+        {
             attr |= FA_ARCHIVE;             /* set the archive flag for files */
+#if CONF_WITH_PEXEC_CACHE
+            pxcache_forget(fd->o_dnode, fd->o_dirbyt);
+#endif
+        }
 
         ixlseek(fd->o_dirfil,fd->o_dirbyt+FNAMELEN);/* seek to attrib byte */
         ixwrite(fd->o_dirfil,1,&attr);          /*  & rewrite it       */
@@ -562,6 +585,12 @@ long ixclose(OFD *fd, int part)
             return EINTRN;  /* some kind of internal error */
     }
 
+#if CONF_WITH_FAT32
+    /* keep the free cluster info on FAT32 drives up to date */
+    if (fd->o_dmd->m_fsidirty)
+        fsinfo_update(fd->o_dmd);
+#endif
+
     /*
      * flush all drives
      *
@@ -570,10 +599,7 @@ long ixclose(OFD *fd, int part)
      * partitioned hard disks.  however this would cost code space and,
      * in practice, flushing usually takes place to one drive only.
      */
-    for (i = BI_FAT; i <= BI_DATA; i++)
-        for (b = bufl[i]; b; b = b->b_link)
-            if ((b->b_bufdrv != -1) && b->b_dirty)
-                flush(b);
+    bufl_flush(-1);
 
     return E_OK;
 }
@@ -649,13 +675,13 @@ long xunlink(char *name)
 long ixdel(DND *dn, FCB *f, long pos)
 {
     OFD *fd;
-    DMD *dm;
-    int n2;
     int n;
     char c;
 
     for (fd = dn->d_files; fd; fd = fd->o_link)
+    {
         if (fd->o_dirbyt == pos)
+        {
             for (n = 0; n < OPNFILES; n++)
                 if (sft[n].f_ofd == fd)
                 {
@@ -664,20 +690,20 @@ long ixdel(DND *dn, FCB *f, long pos)
                     else
                         return EACCDN;
                 }
+#if CONF_WITH_EXTENT_MAP
+            xmap_free(fd->o_dfd);   /* the chain is about to be freed */
+#endif
+        }
+    }
+
+#if CONF_WITH_PEXEC_CACHE
+    pxcache_forget(dn, pos);        /* the file is about to go away */
+#endif
 
     /*
-     * Traverse this file's chain of allocated clusters, freeing them.
+     * Free this file's chain of allocated clusters.
      */
-    dm = dn->d_drv;
-    n = f->f_clust;
-    swpw(n);
-
-    while (n && !endofchain(n))
-    {
-        n2 = getrealcl(n,dm);
-        clfix(n,FREECLUSTER,dm);
-        n = n2;
-    }
+    freechain(getfcbcl(f,dn->d_drv),dn->d_drv);
 
     /*
      * Mark the directory entry as erased.
@@ -687,6 +713,8 @@ long ixdel(DND *dn, FCB *f, long pos)
     c = ERASE_MARKER;
     ixwrite(fd,1L,&c);
     ixclose(fd,CL_DIR);
+    if (pos < dn->d_free)
+        dn->d_free = pos;
 
     /*
      * NOTE that the preceding routines that do physical disk operations
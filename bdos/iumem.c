@@ -12,7 +12,10 @@
 #include "emutos.h"
 #include "fs.h"
 #include "mem.h"
+#include "gemerror.h"
+#include "string.h"
 #include "bdosstub.h"
+#include "has.h"        /* for has_alt_ram */
 
 
 /*
@@ -25,6 +28,233 @@ long ccffit;
 long ccfreeit;
 #endif
 
+#if CONF_WITH_BESTFIT
+static WORD malloc_policy;  /* MP_FIRSTFIT or MP_BESTFIT */
+static MEMSTAT memstat;
+#endif
+
+
+/*
+ *  owner lists
+ *
+ *  so that the memory of a terminating process can be freed without
+ *  scanning the allocated lists of every pool, we keep a list of the
+ *  MDs owned by each process.  the lists are private to the BDOS: the
+ *  MD and PD structures are unchanged.  each list is a chain of OWNBLKs
+ *  (obtained from the OS pool, like MDBLOCKs), and the first OWNBLK of
+ *  each list is also on the chain of all the lists.  empty OWNBLKs are
+ *  freed at once, and blocks owned by the system are not listed.
+ *
+ *  if an OWNBLK cannot be obtained, the MD is not listed and 'ownlost'
+ *  is set.  the next process termination then rebuilds all the lists
+ *  from the allocated lists (see ownrebuild()), which clears it again.
+ */
+#define OWN_MDS     13      /* fills a 64-byte block */
+
+typedef struct _ownblk OWNBLK;
+struct _ownblk
+{
+    OWNBLK  *ob_next;       /* first OWNBLK of next list (first OWNBLK only) */
+    OWNBLK  *ob_more;       /* next OWNBLK of the same list */
+    PD      *ob_pd;         /* owner */
+    MD      *ob_md[OWN_MDS];    /* MDs owned, or NULL if slot is unused */
+};
+
+static OWNBLK *ownroot;     /* chain of owner lists */
+BOOL ownlost;               /* TRUE if some MD is missing from its owner list */
+
+
+/*
+ *  own_head - find the owner list for a process
+ *
+ *  returns a pointer to the link to its first OWNBLK; the link is NULL
+ *  if there is no list for the process
+ */
+static OWNBLK **own_head(PD *p)
+{
+    OWNBLK **prev;
+
+    for (prev = &ownroot; *prev; prev = &(*prev)->ob_next)
+        if ((*prev)->ob_pd == p)
+            break;
+
+    return prev;
+}
+
+
+/*
+ *  own_add - add an MD to the owner list for a process
+ */
+static void own_add(MD *m, PD *p)
+{
+    OWNBLK **head, *ob;
+    WORD i;
+
+    head = own_head(p);
+    for (ob = *head; ob; ob = ob->ob_more)
+    {
+        for (i = 0; i < OWN_MDS; i++)
+        {
+            if (!ob->ob_md[i])
+            {
+                ob->ob_md[i] = m;
+                return;
+            }
+        }
+    }
+
+    ob = xmgetblk(MEMTYPE_MDBLOCK); /* zeroed by xmgetblk() */
+    if (!ob)
+    {
+        KDEBUG(("BDOS own_add: no memory, MD at %p not listed\n",m));
+        ownlost = TRUE;
+        return;
+    }
+
+    ob->ob_pd = p;
+    ob->ob_md[0] = m;
+    if (*head)                  /* add to existing list */
+    {
+        ob->ob_more = (*head)->ob_more;
+        (*head)->ob_more = ob;
+    }
+    else *head = ob;            /* new list, at end of chain */
+}
+
+
+/*
+ *  own_remove - remove an MD from the owner list for a process
+ */
+static void own_remove(MD *m, PD *p)
+{
+    OWNBLK **head, **prev, *ob;
+    WORD i;
+
+    head = own_head(p);
+    for (prev = head; (ob = *prev); prev = &ob->ob_more)
+    {
+        for (i = 0; i < OWN_MDS; i++)
+            if (ob->ob_md[i] == m)
+                break;
+        if (i < OWN_MDS)
+            break;
+    }
+
+    if (!ob)                    /* not listed (see own_add()) */
+        return;
+
+    ob->ob_md[i] = NULL;
+    for (i = 0; i < OWN_MDS; i++)
+        if (ob->ob_md[i])
+            return;
+
+    /*
+     * the OWNBLK is now empty: snip it out, replacing it on the chain
+     * of lists by the next one for the same process if necessary
+     */
+    if (prev == head)
+    {
+        if (ob->ob_more)
+        {
+            ob->ob_more->ob_next = ob->ob_next;
+            *head = ob->ob_more;
+        }
+        else *head = ob->ob_next;
+    }
+    else *prev = ob->ob_more;
+
+    xmfreblk(ob);
+}
+
+
+/*
+ *  ownit - change the owner of a memory descriptor
+ *
+ *  'p' may be NULL if the block belongs to the system.  m->m_own must
+ *  be valid (or NULL) on entry.
+ */
+void ownit(MD *m, PD *p)
+{
+    if (m->m_own)
+        own_remove(m, m->m_own);
+
+    m->m_own = p;
+    if (p)
+        own_add(m, p);
+}
+
+
+/*
+ *  own_addpool - add the allocated MDs of a pool to the owner lists
+ */
+static void own_addpool(MPB *mp)
+{
+    MD *m;
+
+    for (m = mp->mp_mal; m; m = m->m_link)
+        if (m->m_own)
+            own_add(m, m->m_own);
+}
+
+
+/*
+ *  ownrebuild - rebuild all the owner lists from the allocated lists
+ *
+ *  this clears 'ownlost', unless an OWNBLK cannot be obtained again
+ */
+void ownrebuild(void)
+{
+    OWNBLK *ob, *more;
+
+    while ((ob = ownroot) != NULL)
+    {
+        ownroot = ob->ob_next;
+        for ( ; ob; ob = more)
+        {
+            more = ob->ob_more;
+            xmfreblk(ob);
+        }
+    }
+
+    ownlost = FALSE;
+    own_addpool(&pmd);
+#if CONF_WITH_ALT_RAM
+    if (has_alt_ram)
+        own_addpool(&pmdalt);
+#endif
+}
+
+
+/*
+ *  ownnext - remove the next MD from the owner list for a process
+ *
+ *  returns the MD, now without an owner, or NULL if the list is empty.
+ *  a program may have changed m_own behind our back: such MDs are just
+ *  dropped from the list, and the lists are no longer trusted.
+ */
+MD *ownnext(PD *p)
+{
+    OWNBLK *ob;
+    MD *m;
+    WORD i;
+
+    while ((ob = *own_head(p)) != NULL)
+    {
+        for (i = 0; !ob->ob_md[i]; i++) /* an OWNBLK is never empty */
+            ;
+        m = ob->ob_md[i];
+        own_remove(m, p);
+        if (m->m_own == p)
+        {
+            m->m_own = NULL;
+            return m;
+        }
+        ownlost = TRUE;
+    }
+
+    return NULL;
+}
+
 
 /*
  *  ffit - find first fit for requested memory in ospool
@@ -33,6 +263,10 @@ MD *ffit(long amount, MPB *mp)
 {
     MD *p, *q, *p1;     /* free list is composed of MD's */
     LONG maxval;
+#if CONF_WITH_BESTFIT
+    MD *best, *bestp;
+    ULONG total;
+#endif
 
 #ifdef ENABLE_KDEBUG
     if (mp == &pmd)
@@ -82,9 +316,41 @@ MD *ffit(long amount, MPB *mp)
     else
         amount = (amount + MALLOC_ALIGN_ALTRAM) & ~MALLOC_ALIGN_ALTRAM;
 
+#if CONF_WITH_BESTFIT
+    /*
+     * look for the first free space that's large enough, or for the
+     * smallest one if best-fit is selected (an exact fit ends the search)
+     */
+    best = bestp = NULL;
+    total = 0UL;
+    for ( ; q; p = q, q = p->m_link)
+    {
+        memstat.ms_scanned++;
+        total += q->m_length;
+        if (q->m_length >= amount)
+        {
+            if (!best || (q->m_length < best->m_length))
+            {
+                best = q;
+                bestp = p;
+            }
+            if ((malloc_policy == MP_FIRSTFIT) || (q->m_length == amount))
+                break;
+        }
+    }
+    q = best;
+    p = bestp;
+    if (!q)
+    {
+        if (total >= (ULONG)amount)
+            memstat.ms_fails++;
+        KDEBUG(("BDOS ffit: Not enough contiguous memory\n"));
+        return NULL;
+    }
+    memstat.ms_allocs++;
+#else
     /*
      * look for first free space that's large enough
-     * (this could be changed to a best-fit quite easily)
      */
     for ( ; q; p = q, q = p->m_link)
     {
@@ -96,6 +362,7 @@ MD *ffit(long amount, MPB *mp)
         KDEBUG(("BDOS ffit: Not enough contiguous memory\n"));
         return NULL;
     }
+#endif
 
     if (q->m_length == amount)
         p->m_link = q->m_link;  /* take the whole thing */
@@ -128,13 +395,80 @@ MD *ffit(long amount, MPB *mp)
      */
     q->m_link = mp->mp_mal;
     mp->mp_mal = q;
-    q->m_own = run;
+    q->m_own = NULL;        /* free blocks have no valid owner */
+    ownit(q, run);
 
     KDEBUG(("BDOS ffit: start=%p, length=%ld\n",q->m_start,q->m_length));
     return q;
 }
 
 
+#if CONF_WITH_BESTFIT
+/*
+ *  xmpolicy - Function 0x5B (Mpolicy) - EmuTOS extension
+ *
+ *  selects the allocation policy for Malloc() & Mxalloc(), and returns
+ *  the previous one.  a negative 'policy' just returns the current one.
+ */
+long xmpolicy(int policy)
+{
+    WORD old = malloc_policy;
+
+    if (policy > MP_BESTFIT)
+        return ERANGE;
+    if (policy >= 0)
+        malloc_policy = policy;
+
+    return old;
+}
+
+
+/*
+ *  poolstat - get the statistics for the free list of a memory pool
+ */
+static void poolstat(MPB *mp, MPSTAT *s)
+{
+    MD *m;
+    ULONG total, frag;
+
+    bzero(s, sizeof(MPSTAT));
+    for (m = mp->mp_mfl; m; m = m->m_link)
+    {
+        s->mp_nfree++;
+        s->mp_free += m->m_length;
+        if (m->m_length > s->mp_largest)
+            s->mp_largest = m->m_length;
+    }
+
+    /* scale down to avoid an overflow when multiplying by 1000 */
+    total = s->mp_free;
+    frag = total - s->mp_largest;
+    while (total > 4000000UL)
+    {
+        total >>= 1;
+        frag >>= 1;
+    }
+    if (total)
+        s->mp_frag = frag * 1000 / total;
+}
+
+
+/*
+ *  xmstat - update & return the memory statistics for Sstat()
+ */
+MEMSTAT *xmstat(void)
+{
+    memstat.ms_policy = malloc_policy;
+    poolstat(&pmd, &memstat.ms_st);
+#if CONF_WITH_ALT_RAM
+    poolstat(&pmdalt, &memstat.ms_alt);
+#endif
+
+    return &memstat;
+}
+#endif /* CONF_WITH_BESTFIT */
+
+
 /*
  *  freeit - Free up a memory descriptor
  */
@@ -172,12 +506,13 @@ void freeit(MD *m, MPB *mp)
     }
 
     /*
-     * snip it out
+     * snip it out, and remove it from its owner's list
      */
     if (q)
         q->m_link = p->m_link;
     else
         mp->mp_mal = p->m_link;
+    ownit(p, NULL);
 
     /*
      * find where to add it to the free list
@@ -244,6 +579,7 @@ WORD shrinkit(MD *m, MPB *mp, LONG newlen)
      */
     f->m_link = mp->mp_mal;
     mp->mp_mal = f;
+    f->m_own = NULL;
 
     /*
      * Update existing memory descriptor.
@@ -14,10 +14,13 @@
 
 #include "emutos.h"
 #include "fs.h"
+#include "mem.h"
 #include "proc.h"
 #include "gemerror.h"
 #include "pghdr.h"
 #include "string.h"
+#include "has.h"        /* for has_alt_ram */
+#include "tosvars.h"
 
 
 /*
@@ -25,7 +28,72 @@
  */
 
 static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd);
-static LONG pgfix01(UBYTE *lastcp, LONG nrelbytes, PGMINFO *pi);
+static LONG pgfix01(UBYTE **pcp, UBYTE *rp, LONG nrelbytes, PGMINFO *pi);
+static LONG pgminit01(PD *p, PGMHDR01 *hd, PGMINFO *pi);
+static void pgmclr01(PD *p, PGMHDR01 *hd, PGMINFO *pi);
+
+/*
+ * length of the magic number & header at the start of the file
+ */
+#define PGMHDRLEN   (sizeof(WORD) + sizeof(PGMHDR01))
+
+/*
+ * symbol tables longer than this are skipped with a seek, rather than
+ * read along with the rest of the program
+ */
+#define MAXSYMREAD  (16*1024L)
+
+PLSTAT plstat;
+static ULONG rwabs_start;   /* rwabs_calls when the header was read */
+
+
+#if CONF_WITH_PEXEC_CACHE
+
+/*
+ * program image cache
+ *
+ * each cached program is kept in a block of Alt-RAM owned by the system.
+ * the block starts with a PXENTRY, followed by the TEXT & DATA segments
+ * as they were read from the file (i.e. unrelocated), followed by the
+ * offsets from the start of the TEXT segment of the longwords to relocate.
+ *
+ * a program is identified by the position of its directory entry, its
+ * start cluster, its length and its time & date; so a program that has
+ * been rewritten or replaced is not found in the cache.
+ */
+#define PXLIMIT (CONF_PEXEC_CACHE_SIZE * 1024L)
+
+typedef struct pxentry PXENTRY;
+struct pxentry
+{
+    PXENTRY *px_next;   /* next entry, in LRU order */
+    MD      *px_md;     /* memory block containing this entry */
+    WORD    px_drv;     /* drive number */
+    CLNO    px_dircl;   /* start cluster of the directory */
+    long    px_dirbyt;  /* position of the entry in the directory */
+    CLNO    px_strtcl;  /* start cluster of the file */
+    long    px_fileln;  /* length of the file */
+    DOSTIME px_td;      /* time & date of the file */
+    long    px_flen;    /* length of TEXT + DATA */
+    long    px_nrel;    /* number of relocation offsets, or -1 if the */
+                        /*  entry is still being filled                */
+};
+
+PXSTAT pxstat = { 0, 0, PXLIMIT };
+
+static PXENTRY *pxlist;     /* most recently used first */
+static PXENTRY *pxcur;      /* the entry for the program being loaded */
+static ULONG *pxrel;        /* where to store the next relocation offset */
+
+#define PXIMAGE(px)     ((UBYTE *)((px) + 1))
+#define PXRELOC(px)     ((ULONG *)(PXIMAGE(px) + (((px)->px_flen+3) & ~3L)))
+
+static void pxprepare(FH h, PGMHDR01 *hd);
+static void pxfree(PXENTRY **q);
+static LONG pxload(PD *p, PGMHDR01 *hd, PXENTRY *px);
+static void pxdone(LONG r);
+
+#endif
 
 /*
  * kpgmhdrld - load program header
@@ -40,6 +108,8 @@ LONG kpgmhdrld(FH h, PGMHDR01 *hd)
     LONG r;
     WORD magic;
 
+    rwabs_start = rwabs_calls;
+
     r = xread(h, 2L, &magic);   /* read magic number */
     if (r < 0L)
         return r;
@@ -78,7 +148,27 @@ LONG kpgmld(PD *p, FH h, PGMHDR01 *hd)
 {
     LONG r;
 
+#if CONF_WITH_PEXEC_CACHE
+    pxprepare(h, hd);
+    if (pxcur && (pxcur->px_nrel >= 0))
+    {
+        r = pxload(p, hd, pxcur);
+        pxcur = NULL;
+        xclose(h);
+        return r;
+    }
+    pxstat.px_misses++;
+    if (pxcur)
+        pxrel = PXRELOC(pxcur);
+#endif
+
     r = pgmld01(h, p, hd);
+    plstat.pl_rwabs += rwabs_calls - rwabs_start;
+
+#if CONF_WITH_PEXEC_CACHE
+    if (pxcur)
+        pxdone(r);
+#endif
 
     KDEBUG(("BDOS pgmld01: return code=0x%lx\n",r));
 
@@ -93,12 +183,16 @@ LONG kpgmld(PD *p, FH h, PGMHDR01 *hd)
  * handle 'h' using load file strategy like cp/m 68k.  Specifically:
  *
  * - read in program header and determine format parameters
- * - seek past the symbol table to the start of the relo info
+ * - if the rest of the file fits in the TPA (and the symbol table is
+ *   not too big), read it all in one go: the relocation info then ends
+ *   up in the bss area, after the symbol table
+ * - otherwise read the text & data, then seek past the symbol table to
+ *   the start of the relo info
  * - read in the first offset (it's different than the rest in that
  *   it is a longword instead of a byte).
  * - make the first adjustment until we run out of relocation info or
  *   we have an error
- * - read in relocation info into the bss area
+ * - if not already in memory, read in relocation info into the bss area
  * - call pgfix01() to fix up the code using that info
  * - zero out the bss
  */
@@ -108,64 +202,93 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
     PD      *p;
     PGMINFO pinfo;
     UBYTE   *cp;
+    UBYTE   *rp;
     LONG    relst;
     LONG    flen;
+    LONG    rlen;
     LONG    r;
+    LONG    start;
+    BOOL    onepass;
 
     pi = &pinfo;
     p = pdptr;
     relst = 0;
 
-    /* calculate program load info */
-
-    pi->pi_tlen=hd->h01_tlen;
-    pi->pi_dlen=hd->h01_dlen;
+    r = pgminit01(p, hd, pi);
+    if (r < 0)
+        return r;
     flen = pi->pi_tlen + pi->pi_dlen;
 
-    pi->pi_blen = hd->h01_blen;
-    pi->pi_slen = hd->h01_slen;
-    pi->pi_tpalen = p->p_hitpa - p->p_lowtpa - sizeof(PD);
-    pi->pi_tbase = (UBYTE *) (p+1);     /*  1st byte after PD   */
-    pi->pi_bbase = pi->pi_tbase + flen;
-    pi->pi_dbase = pi->pi_tbase + pi->pi_tlen;
-
+    plstat.pl_loads++;
+    plstat.pl_bytes += PGMHDRLEN;
 
     /*
-     * see if there is enough room to load in the file, then see if
-     * the requested bss space is larger than the space we have to offer
+     * decide how much to read: normally the whole of the rest of the file,
+     * but only the text and data if there is no relocation info, if the
+     * symbol table is big enough to be worth skipping, or if there is not
+     * enough room in the TPA
      */
+    rlen = flen;
+    if (!hd->h01_abs && (pi->pi_slen <= MAXSYMREAD))
+    {
+        LONG len = getofd(h)->o_dfd->o_fileln - PGMHDRLEN;
 
-    if ((flen > pi->pi_tpalen) || (pi->pi_tpalen-flen < pi->pi_blen))
-        return ENSMEM;
-
-    /* initialize PD fields */
-
-    memcpy(&p->p_tbase, &pi->pi_tbase, 6 * sizeof(long));
+        if ((len > flen) && (len <= pi->pi_tpalen))
+            rlen = len;
+    }
+    onepass = (rlen > flen);
 
     /*
-     * read in the program file (text and data)
+     * read in the program file (text and data, and possibly the rest)
      */
 
-    r = xread(h,flen,pi->pi_tbase);
+    r = xread(h,rlen,pi->pi_tbase);
     if (r < 0)
         return r;
+    plstat.pl_bytes += r;
 
-    if (!hd->h01_abs)
+#if CONF_WITH_PEXEC_CACHE
+    /* keep a copy of the unrelocated image, if it is complete */
+    if (pxcur)
     {
+        if (r >= flen)
+            memcpy(PXIMAGE(pxcur), pi->pi_tbase, flen);
+        else
+            pxrel = NULL;
+    }
+#endif
 
-        /*
-         * if not an absolute format, position past the symbols and start
-         * the reloc pointer (flen is tlen + dlen).
-         */
-
-        /**********  should change hard coded 0x1c  ******************/
-
-        KDEBUG(("BDOS pgmld01: flen=0x%lx, pi_slen=0x%lx\n",flen,pi->pi_slen));
-
-        r = xlseek(flen+pi->pi_slen+0x1c,h,0);
-
-        if (!(r < 0L))
-            r = xread(h,(long)sizeof(relst),&relst);
+    if (!hd->h01_abs)
+    {
+        if (onepass)
+        {
+            /* the relocation info is already in memory, after the symbols */
+            plstat.pl_onepass++;
+            rp = pi->pi_tbase + flen + pi->pi_slen;
+            rlen = r - (rp - pi->pi_tbase) - (LONG)sizeof(relst);
+            if (rlen >= 0)
+                relst = *(LONG *)rp;
+            rp += sizeof(relst);
+        }
+        else
+        {
+            /*
+             * if not an absolute format, position past the symbols and start
+             * the reloc pointer (flen is tlen + dlen).
+             */
+
+            KDEBUG(("BDOS pgmld01: flen=0x%lx, pi_slen=0x%lx\n",flen,pi->pi_slen));
+
+            r = xlseek(flen+pi->pi_slen+PGMHDRLEN,h,0);
+
+            if (!(r < 0L))
+                r = xread(h,(long)sizeof(relst),&relst);
+            if (r > 0)
+                plstat.pl_bytes += r;
+            else
+                relst = 0;
+            rp = pi->pi_bbase;
+        }
 
         KDEBUG(("BDOS pgmld01: relst=0x%lx\n",relst));
 
@@ -173,7 +296,7 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
          * Atari TOS does not fail loading a program if reading the relocation
          * start address fails. In this case, it just does not relocate.
          */
-        if ((r > 0) && (relst != 0))
+        if (relst != 0)
         {
             cp = pi->pi_tbase + relst;
 
@@ -182,30 +305,94 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
             if ((cp < pi->pi_tbase) || (cp >= pi->pi_bbase))
                 return EPLFMT;
 
-            *((long *)(cp)) += (long)pi->pi_tbase ; /*  1st fixup     */
+            start = hz_200;
 
-            flen = (long)p->p_hitpa - (long)pi->pi_bbase;   /* M01.01.0925.01 */
+            *((long *)(cp)) += (long)pi->pi_tbase ; /*  1st fixup     */
+            plstat.pl_relocs++;
+#if CONF_WITH_PEXEC_CACHE
+            if (pxrel)
+                *pxrel++ = relst;
+#endif
 
-            for ( ; ; )
+            if (onepass)
             {
-                /*  read in more relocation info  */
-                r = xread(h,flen,pi->pi_bbase);
-                if (r <= 0)
-                    break;
-
-                /*  do fixups using that info  */
-                r = pgfix01(cp, r, pi);
-                if (r <= 0)
-                    break;
+                r = pgfix01(&cp, rp, rlen, pi);
+            }
+            else
+            {
+                flen = (long)p->p_hitpa - (long)pi->pi_bbase;   /* M01.01.0925.01 */
+
+                for ( ; ; )
+                {
+                    /*  read in more relocation info  */
+                    r = xread(h,flen,pi->pi_bbase);
+                    if (r <= 0)
+                        break;
+                    plstat.pl_bytes += r;
+
+                    /*  do fixups using that info  */
+                    r = pgfix01(&cp, pi->pi_bbase, r, pi);
+                    if (r <= 0)
+                        break;
+                }
             }
 
+            plstat.pl_reloctime += hz_200 - start;
+
             if (r < 0)                      /* M01.01.1023.01 */
                 return r;
         }
 
     }
 
-    /* clear the bss or the whole heap */
+    pgmclr01(p, hd, pi);
+
+    return 0;
+}
+
+
+/*
+ * pgminit01 - calculate the program load info, check that the program
+ * fits in the TPA and initialize the PD fields
+ */
+static LONG pgminit01(PD *p, PGMHDR01 *hd, PGMINFO *pi)
+{
+    LONG flen;
+
+    pi->pi_tlen=hd->h01_tlen;
+    pi->pi_dlen=hd->h01_dlen;
+    flen = pi->pi_tlen + pi->pi_dlen;
+
+    pi->pi_blen = hd->h01_blen;
+    pi->pi_slen = hd->h01_slen;
+    pi->pi_tpalen = p->p_hitpa - p->p_lowtpa - sizeof(PD);
+    pi->pi_tbase = (UBYTE *) (p+1);     /*  1st byte after PD   */
+    pi->pi_bbase = pi->pi_tbase + flen;
+    pi->pi_dbase = pi->pi_tbase + pi->pi_tlen;
+
+
+    /*
+     * see if there is enough room to load in the file, then see if
+     * the requested bss space is larger than the space we have to offer
+     */
+
+    if ((flen > pi->pi_tpalen) || (pi->pi_tpalen-flen < pi->pi_blen))
+        return ENSMEM;
+
+    /* initialize PD fields */
+
+    memcpy(&p->p_tbase, &pi->pi_tbase, 6 * sizeof(long));
+
+    return 0;
+}
+
+
+/*
+ * pgmclr01 - clear the bss or the whole heap
+ */
+static void pgmclr01(PD *p, PGMHDR01 *hd, PGMINFO *pi)
+{
+    LONG flen;
 
     if (hd->h01_flags & PF_FASTLOAD)
     {
@@ -217,60 +404,322 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
     }
     if (flen > 0)
         bzero(pi->pi_bbase, flen);
-
-    return 0;
 }
 
 
 /*
  * pgfix01 - do the next set of fixups
  *
+ * each relocation byte is either 1 (advance by 254 bytes without any
+ * fixup), or an even offset to the next longword to fix up, or 0 (end
+ * of the relocation info).  the position of the last fixup is kept in
+ * *pcp, so that the next set can carry on from there.
+ *
  *  returns:
- *      addr of last modified longword in code segment (cp)
- *      0 if error or done
- *      stat01:
- *              >0: all offsets in bss used up, read in more
- *              =0: offset of 0 encountered, no more fixups
- *              <0: EPLFMT (load file format error)
+ *      >0: all relocation bytes used up, read in more
+ *      =0: offset of 0 encountered, no more fixups
+ *      <0: EPLFMT (load file format error)
  *
  * Arguments:
+ *  pcp       - ptr to the address of the last modified longword
+ *  rp        - relocation info pointer
  *  nrelbytes - number of avail rel values
  *  pi        - program info pointer
  */
 
-static LONG pgfix01(UBYTE *lastcp, LONG nrelbytes, PGMINFO *pi)
+static LONG pgfix01(UBYTE **pcp, UBYTE *rp, LONG nrelbytes, PGMINFO *pi)
 {
     UBYTE *cp;              /*  code pointer                */
-    UBYTE *rp;              /*  relocation info pointer     */
-    LONG  n;                /*  nbr of relocation bytes     */
+    UBYTE *rend;            /*  end of relocation info      */
     UBYTE *bbase;           /*  base addr of bss segment    */
     LONG  tbase;            /*  base addr of text segment   */
+    ULONG n;                /*  nbr of fixups done          */
+    UWORD c;
+    LONG  r;
 
-    cp = lastcp;
-    rp = pi->pi_bbase;
-    n = nrelbytes;
+    cp = *pcp;
+    n = 0;
+    rend = rp + nrelbytes;
     tbase = (LONG)pi->pi_tbase;
     bbase = pi->pi_bbase;
+    r = 1;
 
-    while(n-- && (*rp != 0))
+    while (rp < rend)
     {
-        if (*rp == 1)
+        c = *rp++;
+        if (c == 1)
+        {
             cp += 0xfe;
-        else
+            continue;
+        }
+        if (c == 0)
         {
-            cp += *rp;  /* add the byte at rp to cp, don't sign ext */
+            r = 0;
+            break;
+        }
 
-            if (cp >= bbase)
-                return EPLFMT;
-            if (((LONG)cp) & 1)
-                return EPLFMT;
-            *((long *)cp) += tbase;
+        cp += c;    /* add the byte at rp to cp, don't sign ext */
+
+        if ((cp >= bbase) || (((LONG)cp) & 1))
+            return EPLFMT;
+        *((long *)cp) += tbase;
+        n++;
+#if CONF_WITH_PEXEC_CACHE
+        if (pxrel)
+            *pxrel++ = (LONG)cp - tbase;
+#endif
+    }
+
+    plstat.pl_relocs += n;
+    *pcp = cp;
+
+    return r;
+}
+
+
+#if CONF_WITH_PEXEC_CACHE
+/*
+ * pxprepare - look for the program in the cache
+ *
+ * this is called by kpgmld(), so the TPA has already been allocated.
+ * if the program is not found, room is made for it in the cache (if
+ * possible), so that pgmld01() can fill the entry.  the entry is made
+ * big enough for the most relocation offsets that the file can hold;
+ * pxdone() gives back what is not used, before the program runs.
+ */
+static void pxprepare(FH h, PGMHDR01 *hd)
+{
+    PXENTRY *px, **q;
+    OFD *f;
+    DFD *d;
+    MD *m;
+    LONG flen, relbytes, size;
+
+    pxcur = NULL;
+    pxrel = NULL;
+
+    f = getofd(h);
+    if (!f || !f->o_dnode || !has_alt_ram)
+        return;
+
+    /* the file may be being written via another handle */
+    d = f->o_dfd;
+    if (d->o_flag & O_DIRTY)
+        return;
+
+    flen = hd->h01_tlen + hd->h01_dlen;
+
+    for (q = &pxlist; (px = *q) != NULL; )
+    {
+        if (px->px_nrel < 0)            /* left over from an aborted load */
+        {
+            pxfree(q);
+            continue;
+        }
+        if ((px->px_drv == f->o_dmd->m_drvnum)
+         && (px->px_dircl == f->o_dnode->d_strtcl)
+         && (px->px_dirbyt == f->o_dirbyt)
+         && (px->px_strtcl == d->o_strtcl)
+         && (px->px_fileln == d->o_fileln)
+         && (px->px_td.time == d->o_td.time)
+         && (px->px_td.date == d->o_td.date)
+         && (px->px_flen == flen))
+        {
+            *q = px->px_next;           /* move it to the head of the list */
+            px->px_next = pxlist;
+            pxlist = px;
+            pxcur = px;
+            return;
         }
-        ++rp;
+        q = &px->px_next;
+    }
+
+    /*
+     * the relocation info follows the symbol table: there cannot be more
+     * relocation offsets than there are bytes of relocation info
+     */
+    relbytes = 0L;
+    if (!hd->h01_abs)
+    {
+        relbytes = d->o_fileln - PGMHDRLEN - flen - hd->h01_slen;
+        if (relbytes < 0)
+            relbytes = 0L;
+    }
+    size = sizeof(PXENTRY) + ((flen+3) & ~3L) + relbytes * sizeof(ULONG);
+    if (size > PXLIMIT)
+        return;
+
+    /* stay within the limit, discarding the least recently used programs */
+    while (pxlist && (pxstat.px_bytes + size > PXLIMIT))
+    {
+        for (q = &pxlist; (*q)->px_next; q = &(*q)->px_next)
+            ;
+        pxfree(q);
+        pxstat.px_evictions++;
+    }
+
+    /* leave most of what is left of the Alt-RAM to the program's Malloc() */
+    if (size > (LONG)ffit(-1L, &pmdalt) / 2)
+        return;
+
+    m = ffit(size, &pmdalt);
+    if (!m)
+        return;
+    ownit(m, NULL);     /* belongs to the system */
+
+    px = (PXENTRY *)m->m_start;
+    px->px_md = m;
+    px->px_drv = f->o_dmd->m_drvnum;
+    px->px_dircl = f->o_dnode->d_strtcl;
+    px->px_dirbyt = f->o_dirbyt;
+    px->px_strtcl = d->o_strtcl;
+    px->px_fileln = d->o_fileln;
+    px->px_td = d->o_td;
+    px->px_flen = flen;
+    px->px_nrel = -1L;
+
+    px->px_next = pxlist;
+    pxlist = px;
+    pxstat.px_entries++;
+    pxstat.px_bytes += m->m_length;
+
+    pxcur = px;
+}
+
+
+/*
+ * pxcache_purge - forget about the cached programs from drive 'drv',
+ * or about all of them if 'drv' is negative
+ */
+void pxcache_purge(int drv)
+{
+    PXENTRY **q;
+
+    pxcur = NULL;
+
+    for (q = &pxlist; *q; )
+    {
+        if ((drv < 0) || ((*q)->px_drv == drv))
+            pxfree(q);
+        else
+            q = &(*q)->px_next;
+    }
+}
+
+
+/*
+ * pxcache_forget - forget about the cached program whose directory
+ * entry is at offset 'pos' in directory 'dn'.  this is called when
+ * the file is written, deleted, truncated or given a new time/date,
+ * since none of these need change the fields that pxprepare() checks
+ */
+void pxcache_forget(DND *dn, long pos)
+{
+    PXENTRY **q;
+
+    if (!dn)
+        return;
+
+    for (q = &pxlist; *q; )
+    {
+        if (((*q)->px_drv == dn->d_drv->m_drvnum)
+         && ((*q)->px_dircl == dn->d_strtcl)
+         && ((*q)->px_dirbyt == pos))
+        {
+            if (*q == pxcur)
+                pxcur = NULL;
+            pxfree(q);
+        }
+        else
+            q = &(*q)->px_next;
+    }
+}
+
+
+/*
+ * pxfree - remove an entry from the cache & free its memory
+ */
+static void pxfree(PXENTRY **q)
+{
+    PXENTRY *px = *q;
+
+    *q = px->px_next;
+    pxstat.px_entries--;
+    pxstat.px_bytes -= px->px_md->m_length;
+    freeit(px->px_md, &pmdalt);
+}
+
+
+/*
+ * pxload - load a program from the cache: this is the equivalent of
+ * pgmld01(), without any file access
+ */
+static LONG pxload(PD *p, PGMHDR01 *hd, PXENTRY *px)
+{
+    PGMINFO pinfo;
+    UBYTE *tbase;
+    ULONG *rp;
+    LONG n, r;
+
+    r = pgminit01(p, hd, &pinfo);
+    if (r < 0)
+        return r;
+
+    tbase = pinfo.pi_tbase;
+    memcpy(tbase, PXIMAGE(px), px->px_flen);
+
+    for (n = px->px_nrel, rp = PXRELOC(px); n > 0; n--)
+        *(LONG *)(tbase + *rp++) += (LONG)tbase;
+
+    pgmclr01(p, hd, &pinfo);
+
+    pxstat.px_hits++;
+
+    return 0;
+}
+
+
+/*
+ * pxdone - complete the cache entry filled by pgmld01(), or discard it
+ * if the program could not be loaded
+ */
+static void pxdone(LONG r)
+{
+    PXENTRY *px, **q;
+    ULONG *rel;
+    LONG size;
+
+    px = pxcur;
+    rel = pxrel;
+    pxcur = NULL;
+    pxrel = NULL;
+
+    for (q = &pxlist; *q && (*q != px); q = &(*q)->px_next)
+        ;
+    if (!*q)
+        return;
+
+    if ((r < 0) || !rel)
+    {
+        pxfree(q);
+        return;
+    }
+
+    px->px_nrel = rel - PXRELOC(px);
+
+    /* give back the memory reserved for relocation offsets but not used */
+    size = ((UBYTE *)PXRELOC(px) - (UBYTE *)px) + px->px_nrel * sizeof(ULONG);
+    size = (size + MALLOC_ALIGN_ALTRAM) & ~MALLOC_ALIGN_ALTRAM;
+    if (size < px->px_md->m_length)
+    {
+        pxstat.px_bytes -= px->px_md->m_length;
+        shrinkit(px->px_md, &pmdalt, size);
+        pxstat.px_bytes += px->px_md->m_length;
     }
 
-    return (++n == 0) ? 1 : 0;
+    pxstat.px_fills++;
 }
+#endif /* CONF_WITH_PEXEC_CACHE */
 
 
 #if DETECT_NATIVE_FEATURES
@@ -344,7 +793,7 @@ LONG kpgm_relocate(PD *p, long length)
             memmove(pi->pi_bbase, rp, length);
 
             /* fixup with the reloc information available */
-            pgfix01(cp, length, pi);
+            pgfix01(&cp, pi->pi_bbase, length, pi);
         }
     }
 
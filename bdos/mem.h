@@ -42,10 +42,15 @@ void *xmgetblk(WORD memtype);
 
 /*  MGET - wrapper around xmgetblk */
 #define MGET(x)         ((x *)xmgetblk(MEMTYPE_ ## x))
-#define MEMTYPE_MDBLOCK 0   /* the 4 types of valid request, all needing 64 bytes */
+#define MEMTYPE_MDBLOCK 0   /* the 6 types of valid request, all needing 64 bytes */
+                            /* (owner lists in iumem.c count as MDBLOCKs) */
 #define MEMTYPE_DMD     1
 #define MEMTYPE_DND     2
 #define MEMTYPE_OFD     3
+#define MEMTYPE_FATMAP  4   /* optional, like MDBLOCK */
+#define MEMTYPE_XMAP    5   /* optional, like MDBLOCK */
+
+extern OSMSTAT osmstat;
 
 /*  xmfreblk - free up memory allocated through mgetblk */
 void xmfreblk(void *m);
@@ -80,6 +85,9 @@ void umem_init(void);
 /* set memory ownership */
 void set_owner(void *addr, PD *p);
 
+/* find the memory pool for an address */
+MPB *find_mpb(void *addr);
+
 
 /*
  * in iumem.c
@@ -91,6 +99,21 @@ MD *ffit(long amount, MPB *mp);
 void freeit(MD *m, MPB *mp);
 /* shrink a memory descriptor */
 WORD shrinkit(MD *m, MPB *mp, LONG newlen);
+/* change the owner of a memory descriptor */
+void ownit(MD *m, PD *p);
+/* remove the next memory descriptor from the owner list of a process */
+MD *ownnext(PD *p);
+/* TRUE if the owner lists may be incomplete */
+extern BOOL ownlost;
+/* rebuild the owner lists from the allocated lists */
+void ownrebuild(void);
+
+#if CONF_WITH_BESTFIT
+/* mpolicy */
+long xmpolicy(int policy);
+/* update & return the memory statistics */
+MEMSTAT *xmstat(void);
+#endif
 
 
 #endif /* MEM_H */
@@ -27,6 +27,7 @@
 #include "mem.h"
 #include "bdosstub.h"
 #include "biosext.h"
+#include "has.h"        /* for has_alt_ram */
 
 /*
  *  local constants
@@ -36,6 +37,14 @@
 /* size of os memory pool, in words: */
 #define LENOSM          (LEN_OSM_BLOCK*NUM_OSM_BLOCKS/sizeof(WORD))
 
+/*
+ * when the pool is down to this many free blocks, we try to add a slab
+ * before satisfying a request: this leaves enough blocks for the MDs
+ * that ffit() may need in order to allocate the slab itself
+ */
+#define OSM_RESERVE     2
+#define OSM_SLAB_SIZE   ((LONG)LEN_OSM_BLOCK*CONF_OSMEM_SLAB_BLOCKS)
+
 
 /*
  *  local typedefs
@@ -77,6 +86,8 @@ WORD *root[MAXQUICK];
 
 static MDBLOCK *mdbroot;    /* root for partially-used MDBLOCKs */
 
+OSMSTAT osmstat;
+
 
 /*
  *  local debug counters
@@ -270,6 +281,50 @@ void xmfremd(MD *md)
 }
 
 
+#if CONF_WITH_OSMEM_SLABS
+/*
+ * growosm - add a slab of blocks to the 'fast' list
+ *
+ * the slab is allocated from Alt-RAM, and belongs to the system.  since
+ * slabs are never given back, ST-RAM is not used: the slab would stay
+ * in the middle of the TPA once the program below it terminates.
+ * this must not be called while allocating an MDBLOCK, since that may
+ * happen in the middle of ffit().
+ */
+static BOOL growosm(void)
+{
+    MD *m;
+    WORD *p;
+    WORD i;
+
+    if (!has_alt_ram || (osmstat.os_slabs >= CONF_OSMEM_MAX_SLABS))
+        return FALSE;
+
+    m = ffit(OSM_SLAB_SIZE, &pmdalt);
+    if (!m)
+    {
+        KDEBUG(("growosm(): no memory for a new slab\n"));
+        return FALSE;
+    }
+    ownit(m, NULL);     /* belongs to the system */
+
+    for (i = 0, p = (WORD *)m->m_start; i < CONF_OSMEM_SLAB_BLOCKS; i++, p += LEN_OSM_BLOCK/sizeof(WORD))
+    {
+        *p = 4;                         /* control word */
+        *((WORD **)(p+1)) = root[4];
+        root[4] = p + 1;
+    }
+
+    osmstat.os_slabs++;
+    osmstat.os_total += CONF_OSMEM_SLAB_BLOCKS;
+    osmstat.os_free += CONF_OSMEM_SLAB_BLOCKS;
+    KDEBUG(("growosm(): added slab at %p\n",m->m_start));
+
+    return TRUE;
+}
+#endif
+
+
 /*
  *  xmgetblk - get a block of memory from the o/s pool.
  *
@@ -279,9 +334,13 @@ void xmfremd(MD *md)
  * are no free blocks on the list, we call getosm to get a block from
  * the os memory pool.
  *
- * If we cannot get memory for an MDBLOCK, we return NULL (the request
- * will fail).  Otherwise we will attempt to free up DNDs to make space
- * and if that fails, the system will be halted.
+ * If the pool is running low, we first try to add a slab of blocks to it.
+ * If we cannot get memory for an MDBLOCK, a FATMAP or an XMAP, we return NULL
+ * (the request will fail).  Otherwise we will attempt to free up DNDs
+ * to make space and if that fails, the system will be halted.
+ *
+ * The type of request is kept in the high byte of the control word, so
+ * that xmfreblk() can maintain the statistics.
  *
  * Arguments:
  *  memtype: the type of request
@@ -290,7 +349,7 @@ void *xmgetblk(WORD memtype)
 {
     WORD i, j, w, *m, *q, **r;
 
-    if ((memtype < MEMTYPE_MDBLOCK) || (memtype > MEMTYPE_OFD))
+    if ((memtype < MEMTYPE_MDBLOCK) || (memtype > MEMTYPE_XMAP))
     {
         dbggtblk++;
         return NULL;
@@ -302,6 +361,11 @@ void *xmgetblk(WORD memtype)
     i = 4;                          /* always from root[4] */
     w = 32;                         /* number of words */
 
+#if CONF_WITH_OSMEM_SLABS
+    if ((memtype != MEMTYPE_MDBLOCK) && (osmstat.os_free <= OSM_RESERVE))
+        growosm();
+#endif
+
     /*
      * we should execute the following loop a maximum of twice: the second
      * time only if we're allocating a DMD/DND/OFD & no memory is available
@@ -322,8 +386,9 @@ void *xmgetblk(WORD memtype)
             break;
         }
 
-        /* no memory available for an MDBLOCK, that's (sort of) OK */
-        if (memtype == MEMTYPE_MDBLOCK)
+        /* no memory available for an optional block, that's (sort of) OK */
+        if ((memtype == MEMTYPE_MDBLOCK) || (memtype == MEMTYPE_FATMAP)
+         || (memtype == MEMTYPE_XMAP))
             break;
 
         /*
@@ -333,6 +398,7 @@ void *xmgetblk(WORD memtype)
          * worked, but we're here again, then it lied and we should quit
          * to avoid an infinite loop
          */
+        osmstat.os_scavenges++;
         if ((j >= 2) || (free_available_dnds() == 0))
         {
             kcprintf(_("\033EOut of internal memory.\nUse FOLDR100.PRG to get more.\nSystem halted!\n"));
@@ -341,13 +407,21 @@ void *xmgetblk(WORD memtype)
     }
 
     /*
-     *  zero out the block
+     *  zero out the block & update the statistics
      */
 
     if ( (q = m) )
+    {
         for (j = 0; j < w; j++)
             *q++ = 0;
 
+        m[-1] = (memtype << 8) | i;
+        if (osmstat.os_free)        /* may be wrong if blocks were added */
+            osmstat.os_free--;      /*  behind our back (FOLDRnnn.PRG)   */
+        if (++osmstat.os_inuse[memtype] > osmstat.os_peak[memtype])
+            osmstat.os_peak[memtype] = osmstat.os_inuse[memtype];
+    }
+
     return m;
 }
 
@@ -357,9 +431,11 @@ void *xmgetblk(WORD memtype)
  */
 void xmfreblk(void *m)
 {
-    WORD i;
+    WORD i, memtype;
 
     i = *(((WORD *)m) - 1);
+    memtype = i >> 8;
+    i &= 0xff;
 
     if (i != 4)
     {
@@ -378,6 +454,10 @@ void xmfreblk(void *m)
         root[i] = m;
         if (*((WORD **)m) == m)
             KDEBUG(("xmfreblk: Circular link in root[0x%x] at 0x%p\n",i,m));
+
+        osmstat.os_free++;
+        if ((memtype < OSM_NTYPES) && osmstat.os_inuse[memtype])
+            osmstat.os_inuse[memtype]--;
     }
 }
 
@@ -389,6 +469,7 @@ void osmem_init(void)
 {
     osmlen = LENOSM;
     mdbroot = NULL;
+    osmstat.os_total = osmstat.os_free = NUM_OSM_BLOCKS;
     dbgfreblk = 0;
     dbggtosm = 0;
     dbggtblk = 0;
@@ -66,6 +66,7 @@ static jmp_buf bakbuf;         /* longjmp buffer */
  */
 static void free_all_owned(PD *p, MPB *mpb);
 static void reserve_blocks(PD *pd, MPB *mpb);
+static void release_owned(PD *p, BOOL reserve);
 
 /* reserve blocks, i.e. remove them from the allocated list
  *
@@ -79,6 +80,7 @@ static void reserve_blocks(PD *p, MPB *mpb)
     for (m = *(q = &mpb->mp_mal); m; m = *q) {
         if (m->m_own == p) {
             *q = m->m_link; /* pouf ! like magic */
+            ownit(m, NULL);
             xmfremd(m);
         } else {
             q = &m->m_link;
@@ -98,6 +100,49 @@ static void free_all_owned(PD *p, MPB *mpb)
     }
 }
 
+/* free (or reserve, see above) each block owned by 'p', via its owner
+ * list; the allocated lists are only searched if the owner lists could
+ * not be made complete
+ */
+static void release_owned(PD *p, BOOL reserve)
+{
+    MD *m, **q;
+    MPB *mpb;
+
+    if (ownlost)
+        ownrebuild();
+
+    while ((m = ownnext(p)) != NULL) {
+        mpb = find_mpb(m->m_start);
+        if (!reserve) {
+            freeit(m, mpb);
+            continue;
+        }
+        for (q = &mpb->mp_mal; *q; q = &(*q)->m_link) {
+            if (*q == m) {
+                *q = m->m_link; /* pouf ! like magic */
+                xmfremd(m);
+                break;
+            }
+        }
+    }
+
+    if (ownlost) {
+        if (reserve)
+            reserve_blocks(p, &pmd);
+        else
+            free_all_owned(p, &pmd);
+#if CONF_WITH_ALT_RAM
+        if (has_alt_ram) {
+            if (reserve)
+                reserve_blocks(p, &pmdalt);
+            else
+                free_all_owned(p, &pmdalt);
+        }
+#endif
+    }
+}
+
 /*
  * ixterm - terminate a process
  *
@@ -129,13 +174,9 @@ static void ixterm(PD *r)
             decr_curdir_usage(h);
     }
 
-    /* free each item in the allocated list that is owned by 'r' */
+    /* free each block that is owned by 'r' */
 
-    free_all_owned(r, &pmd);
-#if CONF_WITH_ALT_RAM
-    if (has_alt_ram)
-        free_all_owned(r, &pmdalt);
-#endif
+    release_owned(r, FALSE);
 }
 
 
@@ -622,10 +663,6 @@ WORD xtermres(long blkln, WORD rc)
 {
     xsetblk(0,run,blkln);
 
-    reserve_blocks(run, &pmd);
-#if CONF_WITH_ALT_RAM
-    if (has_alt_ram)
-        reserve_blocks(run, &pmdalt);
-#endif
+    release_owned(run, TRUE);
     xterm(rc);
 }
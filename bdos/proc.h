@@ -32,9 +32,17 @@ WORD xtermres(long blkln, WORD rc);
  * in kpgmld.c
  */
 
+extern PLSTAT plstat;
+
 LONG kpgmhdrld(FH h, PGMHDR01 *hd);
 LONG kpgmld(PD *p, FH h, PGMHDR01 *hd);
 
+#if CONF_WITH_PEXEC_CACHE
+extern PXSTAT pxstat;
+void pxcache_purge(int drv);
+void pxcache_forget(DND *dn, long pos);
+#endif
+
 #if DETECT_NATIVE_FEATURES
 LONG kpgm_relocate( PD *p, long length); /* SOP */
 #endif
@@ -96,7 +96,7 @@ static void dump_mem_map(void)
  *
  * returns NULL if not found
  */
-static MPB *find_mpb(void *addr)
+MPB *find_mpb(void *addr)
 {
     if (((UBYTE *)addr >= start_stram) && ((UBYTE *)addr < end_stram))
         return &pmd;
@@ -574,7 +574,7 @@ void set_owner(void *addr, PD *p)
 
     for (m = mpb->mp_mal; m; m = m->m_link) {
         if (m->m_start == (UBYTE *)addr) {
-            m->m_own = p;
+            ownit(m, p);
             return;
         }
     }
@@ -798,6 +798,12 @@ void biosmain(void)
         Pexec(PE_GO, "", (char *)pd, default_env);
     }
 
+    /* make sure that the disks are up to date */
+    osflush();
+#if CONF_WITH_RWQUEUE
+    rwq_flush(-1);
+#endif
+
 #if CONF_WITH_SHUTDOWN
     /* try to shutdown the machine / close the emulator */
     shutdown();
@@ -27,11 +27,14 @@
 #include "scsi.h"
 #include "ide.h"
 #include "sd.h"
+#include "ramdisk.h"
+#include "rwqueue.h"
 #include "scsidriv.h"
 #include "biosext.h"
 #include "biosmem.h"
 #include "xhdi.h"
 #include "intmath.h"
+#include "../bdos/bdosstub.h"
 
 
 /*
@@ -55,6 +58,7 @@ static PUN_INFO pun_info;
 static LONG blkdev_hdv_boot(void);
 static void blkdev_hdv_init(void);
 static LONG blkdev_mediach(WORD dev);
+static LONG check_mediach(WORD dev, BOOL critic);
 static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LONG lrecnr);
 static LONG bootcheck(void);
 static void bus_init(void);
@@ -109,6 +113,13 @@ void blkdev_init(void)
 
     /* setting drvbits */
     blkdev_hdv_init();
+
+#if CONF_WITH_RWQUEUE
+    rwq_init();         /* needs to know the units */
+#endif
+#if CONF_WITH_FLOPPY_CACHE
+    flopcache_init();   /* likewise */
+#endif
 }
 
 /*
@@ -151,8 +162,8 @@ static void pun_info_setup(void)
             pun_info.pun[i] = physdev;
             pun_info.partition_start[i] = dev->start;
             if (dev->flags & GETBPB_ALLOWED)
-                if (dev->bpb.recsiz > max_size)
-                    max_size = dev->bpb.recsiz;
+                if (dev->xbpb.bpb.recsiz > max_size)
+                    max_size = dev->xbpb.bpb.recsiz;
             if (++i >= PUN_MAXUNITS)    /* cannot store info for devices > P: */
                 break;
         }
@@ -168,6 +179,17 @@ static void pun_info_setup(void)
     KDEBUG(("PUN INFO: max sector size = %u\n",pun_info.max_sect_siz));
 }
 
+/*
+ * report the time taken by a phase of the disk initialisation
+ */
+static void report_time(const char *phase, ULONG start)
+{
+    MAYBE_UNUSED(phase);
+    MAYBE_UNUSED(start);
+
+    KINFO(("%s: %lu ms\n", phase, (hz_200 - start) * (1000 / CLOCKS_PER_SEC)));
+}
+
 /*
  * blkdev_hdv_init
  *
@@ -175,12 +197,16 @@ static void pun_info_setup(void)
 
 static void blkdev_hdv_init(void)
 {
+    ULONG start, phase_start;
+
     /* Start with no drives. This matters for EmuTOS-RAM, because the system
      * variables are not automatically reinitialized. */
     drvbits = 0;
 
     /* Detect and initialize floppy drives */
+    start = phase_start = hz_200;
     flop_hdv_init();
+    report_time("floppy detection", phase_start);
 
     /*
      * do bus initialisation, such as setting delay values
@@ -188,16 +214,22 @@ static void blkdev_hdv_init(void)
     bus_init();
 
 #if CONF_WITH_SCSI_DRIVER
+    phase_start = hz_200;
     scsidriv_init();    /* detect all devices */
+    report_time("SCSI driver", phase_start);
 #endif
 
+    phase_start = hz_200;
     disk_init_all();    /* Detect hard disk partitions */
+    report_time("hard disk units & partitions", phase_start);
 
 #if CONF_WITH_XHDI
     init_XHDI_drvmap(); /* remember drives that we control */
 #endif
 
     pun_info_setup();
+
+    report_time("disk initialisation", start);
 }
 
 /*
@@ -205,20 +237,36 @@ static void blkdev_hdv_init(void)
  */
 static void bus_init(void)
 {
+    ULONG start;
+
+    MAYBE_UNUSED(start);
+
 #if CONF_WITH_ACSI
+    start = hz_200;
     acsi_init();
+    report_time("ACSI init", start);
 #endif
 
 #if CONF_WITH_SCSI
+    start = hz_200;
     scsi_init();
+    report_time("SCSI init", start);
 #endif
 
 #if CONF_WITH_IDE
+    start = hz_200;
     ide_init();
+    report_time("IDE init", start);
 #endif
 
 #if CONF_WITH_SDMMC
+    start = hz_200;
     sd_init();
+    report_time("SD/MMC init", start);
+#endif
+
+#if CONF_WITH_RAMDISK
+    ramdisk_init();
 #endif
 }
 
@@ -442,7 +490,7 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
         if ((dev < 0 ) || (dev >= BLKDEVNUM) || !(blkdev[dev].flags&DEVICE_VALID))
             return EUNDEV;  /* unknown device */
 
-        if (blkdev[dev].bpb.recsiz == 0)/* invalid BPB, e.g. FAT32 or ext2 */
+        if (blkdev[dev].xbpb.bpb.recsiz == 0)/* invalid BPB, e.g. FAT32 or ext2 */
             return ESECNF;              /* (this is an XHDI convention)    */
 
         /*
@@ -455,7 +503,7 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
             blkdev[dev].forcechange = TRUE;
 
         /* convert logical sectors to physical ones */
-        sectors = blkdev[dev].bpb.recsiz >> units[blkdev[dev].unit].psshift;
+        sectors = blkdev[dev].xbpb.bpb.recsiz >> units[blkdev[dev].unit].psshift;
         lcount *= sectors;
         lrecnr *= sectors;
 
@@ -472,8 +520,17 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
 
         KDEBUG(("rwabs translated: sector=%ld, count=%ld\n",lrecnr,lcount));
 
+#if CONF_WITH_RAMDISK
+        /*
+         * the RAM disk can neither fail nor change media, so we skip
+         * the retry & media change handling, and the 15-bit split
+         */
+        if (IS_RAMDISK_DEVICE(unit - NUMFLOPPIES))
+            return ramdisk_rw(rw, lrecnr, lcount, buf, 0);
+#endif
+
         if (! (rw & RW_NOMEDIACH)) {
-            if (blkdev_mediach(dev) != MEDIANOCHANGE) {
+            if (check_mediach(dev, !(rw & RW_NOCRITIC)) != MEDIANOCHANGE) {
                 KDEBUG(("blkdev_rwabs(): media change detected\n"));
                 return E_CHNG;
             }
@@ -481,6 +538,25 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
 
         /* In logical mode RW_NOBYTESWAP is not supported. */
         rw &= ~RW_NOBYTESWAP;
+
+#if CONF_WITH_RWQUEUE
+        /*
+         * queue hard disk writes, unless the caller handles errors itself;
+         * anything else must first write out the queued sectors it overlaps
+         */
+        if (unit >= NUMFLOPPIES) {
+            if ((rw & (RW_WRITE|RW_NORETRIES|RW_NOCRITIC)) == RW_WRITE) {
+                retval = rwq_write(unit, dev, lrecnr, lcount, buf);
+                if (retval == 0L) {
+                    units[unit].last_access = hz_200;
+                    return 0L;
+                }
+            } else
+                retval = rwq_sync(unit, lrecnr, lcount, !(rw & RW_NOCRITIC));
+            if (retval < 0L)
+                return retval;
+        }
+#endif
     }
     else {                              /* physical */
         if (unit < 0 || unit >= UNITSNUM || !units[unit].valid)
@@ -503,6 +579,14 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
                 return E_CHNG;
             }
         }
+
+#if CONF_WITH_RWQUEUE
+        if (unit >= NUMFLOPPIES) {
+            retval = rwq_sync(unit, lrecnr, lcount, !(rw & RW_NOCRITIC));
+            if (retval < 0L)
+                return retval;
+        }
+#endif
     }
 
     psshift = units[unit].psshift;
@@ -519,7 +603,8 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
                 if (retval == E_CHNG)       /* no automatic retry on media change */
                     break;
             } while((retval < 0) && (--retries > 0));
-            if ((retval < 0L) && !(rw & RW_NOTRANSLATE))    /* only call etv_critic for logical requests */
+            /* only call etv_critic for logical requests, if the caller allows it */
+            if ((retval < 0L) && !(rw & (RW_NOTRANSLATE|RW_NOCRITIC)))
                 retval = call_etv_critic((WORD)retval,dev);
         } while(retval == CRITIC_RETRY_REQUEST);
         if (retval < 0)     /* error, retries exhausted */
@@ -573,7 +658,12 @@ LONG blkdev_getbpb(WORD dev)
     BLKDEV *bdev = blkdev + dev;
     struct bs *b;
     struct fat16_bs *b16;
-    ULONG tmp, clsizb;
+#if CONF_WITH_FAT32
+    struct fat32_bs *b32;
+    UWORD flags;
+    BOOL fat32;
+#endif
+    ULONG tmp, clsizb, fsiz, fatrec, datrec;
     LONG ret;
     UWORD reserved, recsiz;
     int n, unit;
@@ -600,7 +690,7 @@ LONG blkdev_getbpb(WORD dev)
      * numbers to physical; and (c) blkdev_rwabs() may be called
      * before blkdev_getbpb() actually reads the value.
      */
-    bdev->bpb.recsiz = (unit < NUMFLOPPIES) ? SECTOR_SIZE : 0;
+    bdev->xbpb.bpb.recsiz = (unit < NUMFLOPPIES) ? SECTOR_SIZE : 0;
 
     /*
      * before we can build the BPB, we need to locate the bootsector.
@@ -674,9 +764,9 @@ LONG blkdev_getbpb(WORD dev)
     KDEBUG(("bootsector[dev=%d] = {\n  ...\n  res = %d;\n  hid = %d;\n}\n",
             dev,getiword(b->res),getiword(b->hid)));
 
-    bdev->bpb.recsiz = recsiz;
-    bdev->bpb.clsiz = b->spc;
-    bdev->bpb.clsizb = clsizb;
+    bdev->xbpb.bpb.recsiz = recsiz;
+    bdev->xbpb.bpb.clsiz = b->spc;
+    bdev->xbpb.bpb.clsizb = clsizb;
 
     /*
      * determine the number of root directory sectors
@@ -685,14 +775,21 @@ LONG blkdev_getbpb(WORD dev)
      * entries is not an exact number of logical sectors, we round up
      */
     tmp = getiword(b->dir);     /* root dir entries */
-    if (bdev->bpb.recsiz != 0)
-        bdev->bpb.rdlen = divu((tmp*32)+(bdev->bpb.recsiz-1),bdev->bpb.recsiz);
+    if (bdev->xbpb.bpb.recsiz != 0)
+        bdev->xbpb.bpb.rdlen = divu((tmp*32)+(bdev->xbpb.bpb.recsiz-1),bdev->xbpb.bpb.recsiz);
     else
-        bdev->bpb.rdlen = 0;
-    if (tmp*32 != bdev->bpb.rdlen*bdev->bpb.recsiz)
+        bdev->xbpb.bpb.rdlen = 0;
+    if (tmp*32 != bdev->xbpb.bpb.rdlen*bdev->xbpb.bpb.recsiz)
         KDEBUG(("root directory length has been rounded up\n"));
 
-    bdev->bpb.fsiz = getiword(b->spf);
+    fsiz = getiword(b->spf);
+#if CONF_WITH_FAT32
+    /* a FAT32 bootsector has the FAT size in a different place */
+    b32 = (struct fat32_bs *)dskbufp;
+    fat32 = (fsiz == 0);
+    if (fat32)
+        fsiz = MAKE_ULONG(getiword(b32->spf32+2), getiword(b32->spf32));
+#endif
 
     /* the structure of the logical disk is assumed to be:
      * - bootsector
@@ -704,15 +801,15 @@ LONG blkdev_getbpb(WORD dev)
     reserved = getiword(b->res);
     if (reserved == 0)      /* should not happen */
         reserved = 1;       /* but if it does, Atari TOS assumes this */
-    bdev->bpb.fatrec = reserved;
+    fatrec = reserved;
     /*
      * with 2 FATs, use 2nd FAT by default.
      * The code that flushes the FATs also assumes this.
      * When support for single FAT is disabled, assume 2 FATs like Atari TOS.
      */
     if (!CONF_WITH_1FAT_SUPPORT || (b->fat >= 2))
-        bdev->bpb.fatrec += bdev->bpb.fsiz;
-    bdev->bpb.datrec = bdev->bpb.fatrec + bdev->bpb.fsiz + bdev->bpb.rdlen;
+        fatrec += fsiz;
+    datrec = fatrec + fsiz + bdev->xbpb.bpb.rdlen;
 
     /*
      * determine number of clusters
@@ -731,36 +828,91 @@ LONG blkdev_getbpb(WORD dev)
      */
     if ((tmp == 0UL) && (unit >= NUMFLOPPIES))
         tmp = MAKE_ULONG(getiword(b16->sec2+2), getiword(b16->sec2));
-    if (tmp < bdev->bpb.datrec)
+    if (tmp < datrec)
         tmp = 0UL;
     else
-        tmp = (tmp - bdev->bpb.datrec) / b->spc;
-    if ((tmp > MAX_FAT16_CLUSTERS) || (bdev->bpb.fsiz == 0))
+        tmp = (tmp - datrec) / b->spc;
+
+#if CONF_WITH_FAT32
+    if (fat32)
     {
-        /* FAT32 - unsupported */
-        KINFO(("Disk %c: is inaccessible (FAT32)\n",dev+'A'));
-        bdev->bpb.recsiz = 0;               /* mark it for XHDI */
-        return 0L;
+        flags = getiword(b32->flags);
+
+        /*
+         * if FAT mirroring is disabled, only the active FAT is valid,
+         * so we treat the disk as having a single FAT
+         */
+        if (flags & FAT32_NOMIRROR)
+        {
+            if (!CONF_WITH_1FAT_SUPPORT || ((flags & FAT32_ACTIVEMASK) >= b->fat))
+                tmp = 0UL;          /* can't handle it */
+            fatrec = reserved + (flags & FAT32_ACTIVEMASK) * fsiz;
+        }
+
+        bdev->xbpb.rootcl = MAKE_ULONG(getiword(b32->rootcl+2), getiword(b32->rootcl));
+        if ((tmp <= MAX_FAT16_CLUSTERS) || (tmp > MAX_FAT32_CLUSTERS)
+         || (fsiz == 0) || (bdev->xbpb.bpb.rdlen != 0) || getiword(b32->version)
+         || (bdev->xbpb.rootcl < 2) || (bdev->xbpb.rootcl >= tmp+2))
+        {
+            KINFO(("Disk %c: is inaccessible (invalid FAT32)\n",dev+'A'));
+            bdev->xbpb.bpb.recsiz = 0;      /* mark it for XHDI */
+            return 0L;
+        }
+
+        /* the 16-bit fields are zeroed for the benefit of old programs */
+        bdev->xbpb.bpb.fsiz = 0;
+        bdev->xbpb.bpb.fatrec = 0;
+        bdev->xbpb.bpb.datrec = 0;
+        bdev->xbpb.bpb.numcl = 0;
+        bdev->xbpb.bpb.b_flags = B_32;
+        if (flags & FAT32_NOMIRROR)
+            bdev->xbpb.bpb.b_flags |= B_1FAT;
+
+        bdev->xbpb.fsiz = fsiz;
+        bdev->xbpb.fatrec = fatrec;
+        bdev->xbpb.datrec = datrec;
+        bdev->xbpb.numcl = tmp;
+        tmp = getiword(b32->fsinfo);
+        bdev->xbpb.fsinfo = ((tmp > 0) && (tmp < reserved)) ? tmp : 0;
     }
-    bdev->bpb.numcl = tmp;
+    else
+#endif
+    {
+        if ((tmp > MAX_FAT16_CLUSTERS) || (fsiz == 0))
+        {
+            /* FAT32 - unsupported */
+            KINFO(("Disk %c: is inaccessible (FAT32)\n",dev+'A'));
+            bdev->xbpb.bpb.recsiz = 0;               /* mark it for XHDI */
+            return 0L;
+        }
+        bdev->xbpb.bpb.fsiz = fsiz;
+        bdev->xbpb.bpb.fatrec = fatrec;
+        bdev->xbpb.bpb.datrec = datrec;
+        bdev->xbpb.bpb.numcl = tmp;
 
-    /*
-     * check for FAT12 or FAT16: according to Microsoft (who originated
-     * the FAT format, after all), FAT type should be determined on the
-     * basis of cluster count and nothing else
-     */
-    bdev->bpb.b_flags = 0;         /* FAT12 */
-    if (bdev->bpb.numcl > MAX_FAT12_CLUSTERS)
-        bdev->bpb.b_flags |= B_16;      /* FAT16 */
+        /*
+         * check for FAT12 or FAT16: according to Microsoft (who originated
+         * the FAT format, after all), FAT type should be determined on the
+         * basis of cluster count and nothing else
+         */
+        bdev->xbpb.bpb.b_flags = 0;         /* FAT12 */
+        if (bdev->xbpb.bpb.numcl > MAX_FAT12_CLUSTERS)
+            bdev->xbpb.bpb.b_flags |= B_16;      /* FAT16 */
 #if CONF_WITH_1FAT_SUPPORT
-    if (b->fat < 2)
-        bdev->bpb.b_flags |= B_1FAT;
+        if (b->fat < 2)
+            bdev->xbpb.bpb.b_flags |= B_1FAT;
 #endif
+    }
 
     /* additional geometry info */
     bdev->geometry.sides = getiword(b->sides);
     bdev->geometry.spt = getiword(b->spt);
     memcpy(bdev->serial,b->serial,3);
+#if CONF_WITH_FAT32
+    if (fat32)
+        memcpy(bdev->serial2,b32->serial2,4);
+    else
+#endif
     memcpy(bdev->serial2,b16->serial2,4);
 
     /* store checksums iff floppy drive */
@@ -768,14 +920,14 @@ LONG blkdev_getbpb(WORD dev)
         flop_checksum(unit, dskbufp);
 
     KDEBUG(("bpb[dev=%d] = {\n  recsiz = %u;\n  clsiz  = %d;\n",
-            dev,bdev->bpb.recsiz,bdev->bpb.clsiz));
+            dev,bdev->xbpb.bpb.recsiz,bdev->xbpb.bpb.clsiz));
     KDEBUG(("  clsizb = %u;\n  rdlen  = %d;\n  fsiz   = %d;\n",
-            bdev->bpb.clsizb,bdev->bpb.rdlen,bdev->bpb.fsiz));
+            bdev->xbpb.bpb.clsizb,bdev->xbpb.bpb.rdlen,bdev->xbpb.bpb.fsiz));
     KDEBUG(("  fatrec = %d;\n  datrec = %d;\n  numcl  = %u;\n",
-            bdev->bpb.fatrec,bdev->bpb.datrec,bdev->bpb.numcl));
-    KDEBUG(("  bflags = %d;\n}\n",bdev->bpb.b_flags));
+            bdev->xbpb.bpb.fatrec,bdev->xbpb.bpb.datrec,bdev->xbpb.bpb.numcl));
+    KDEBUG(("  bflags = %d;\n}\n",bdev->xbpb.bpb.b_flags));
 
-    return (LONG) &bdev->bpb;
+    return (LONG) &bdev->xbpb.bpb;
 }
 
 /*
@@ -783,6 +935,17 @@ LONG blkdev_getbpb(WORD dev)
  */
 
 static LONG blkdev_mediach(WORD dev)
+{
+    return check_mediach(dev, TRUE);
+}
+
+/*
+ * check_mediach - media change detection
+ *
+ * if 'critic' is FALSE, errors are returned without calling the
+ * critical error handler (see RW_NOCRITIC)
+ */
+static LONG check_mediach(WORD dev, BOOL critic)
 {
     BLKDEV *b = &blkdev[dev];
     UWORD unit;
@@ -804,9 +967,21 @@ static LONG blkdev_mediach(WORD dev)
     if (blkdev[dev].forcechange)
         return MEDIACHANGE;
 
+#if CONF_WITH_RWQUEUE
+    /*
+     * write out the sectors queued for the unit first, so that an error
+     * is reported (or not) only once, and is returned to the caller
+     */
+    if (dev >= NUMFLOPPIES) {
+        ret = critic ? rwq_flush(unit) : rwq_quietflush(unit);
+        if (ret < 0L)
+            return ret;
+    }
+#endif
+
     do {
         ret = (dev<NUMFLOPPIES) ? flop_mediach(dev) : disk_mediach(unit);
-        if (ret < 0L)
+        if ((ret < 0L) && critic)
             ret = call_etv_critic((WORD)ret,dev);
     } while(ret == CRITIC_RETRY_REQUEST);
     if (ret < 0L)
@@ -848,3 +1023,27 @@ LONG blkdev_avail(WORD dev)
 {
     return((1L << dev) & drvbits);
 }
+
+
+#if CONF_WITH_LAZY_WRITEBACK || CONF_WITH_RWQUEUE
+/*
+ * blkdev_vblflush - background write-back, called from the VBL interrupt
+ *
+ * 'sr' is the status register of the interrupted code.  since the BDOS
+ * and BIOS always run in supervisor mode, if the interrupted code was in
+ * user mode, neither of them can be active: the BDOS buffers and the
+ * write queue are consistent, and Rwabs() may be called.
+ */
+void blkdev_vblflush(UWORD sr)
+{
+    if (sr & 0x2000)
+        return;
+
+#if CONF_WITH_LAZY_WRITEBACK
+    bufl_lazyflush();
+#endif
+#if CONF_WITH_RWQUEUE
+    rwq_vblflush();
+#endif
+}
+#endif
@@ -23,4 +23,8 @@
  * value without trying to read the actual memory.
  */
 
+#if CONF_WITH_RAMDISK
+ULONG ramdisk_kbytes = RAMDISK_KBYTES_UNSET;
+#endif
+
 #endif /* EMUTOS_LIVES_IN_RAM */
@@ -13,4 +13,13 @@
 #ifndef BOOTPARAMS_H
 #define BOOTPARAMS_H
 
+#if EMUTOS_LIVES_IN_RAM
+
+#if CONF_WITH_RAMDISK
+#define RAMDISK_KBYTES_UNSET 0xffffffffUL
+extern ULONG ramdisk_kbytes;    /* RAM disk size, overrides NVRAM */
+#endif
+
+#endif /* EMUTOS_LIVES_IN_RAM */
+
 #endif /* BOOTPARAMS_H */
@@ -18,6 +18,7 @@
 #include "biosdefs.h"
 #include "country.h"
 #include "nvram.h"
+#include "biosext.h"
 #include "../obj/header.h"
 #include "bios.h"
 
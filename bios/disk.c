@@ -24,6 +24,9 @@
 #include "acsi.h"
 #include "scsi.h"
 #include "sd.h"
+#include "ramdisk.h"
+#include "rwqueue.h"
+#include "biosext.h"
 #include "../bdos/bdosstub.h"
 #include "string.h"
 
@@ -221,7 +224,10 @@ void disk_init_all(void)
         0, 1, 2, 3, 4, 5, 6, 7,             /* ACSI */
 #endif
 #if CONF_WITH_SDMMC
-        24, 25, 26, 27, 28, 29, 30, 31      /* SD/MMC */
+        24, 25, 26, 27, 28, 29, 30, 31,     /* SD/MMC */
+#endif
+#if CONF_WITH_RAMDISK
+        32                                  /* RAM disk */
 #endif
     };
     int i;
@@ -310,6 +316,17 @@ LONG disk_mediach(UWORD unit)
     if (hz_200 < units[unit].last_access + CLOCKS_PER_SEC/2)
         return MEDIANOCHANGE;
 
+#if CONF_WITH_RWQUEUE
+    /*
+     * queued sectors must go to the media that they were written to.
+     * blkdev_mediach() has normally done this already; if not, any
+     * error has been reported, and is returned like any other.
+     */
+    ret = rwq_flush(unit);
+    if (ret < 0L)
+        return ret;
+#endif
+
     /* get bus and relative device */
     bus = GET_BUS(major);
     reldev = major - bus * DEVICES_PER_BUS;
@@ -337,6 +354,11 @@ LONG disk_mediach(UWORD unit)
         ret = sd_ioctl(reldev,GET_MEDIACHANGE,NULL);
         break;
 #endif /* CONF_WITH_SDMMC */
+#if CONF_WITH_RAMDISK
+    case RAMDISK_BUS:
+        ret = ramdisk_ioctl(reldev,GET_MEDIACHANGE,NULL);
+        break;
+#endif /* CONF_WITH_RAMDISK */
     default:
         ret = EUNDEV;
     }
@@ -362,6 +384,10 @@ void disk_rescan(UWORD unit)
 
     KDEBUG(("disk_rescan(%d):drivemap=0x%08lx\n",unit,devices_available));
 
+#if CONF_WITH_RWQUEUE
+    rwq_discard(unit);  /* too late to write them */
+#endif
+
     /* rescan (this clobbers 'devices_available') */
     disk_init_one(unit,&devices_available);
 
@@ -715,10 +741,11 @@ static WORD process_dos_mbr(UWORD unit, LONG *devices_available)
             case 0x83:      /* any Linux partition, including ext2 */
                 /*
                  * note that FAT32 & Linux partitions occupy drive letters,
-                 * but are not yet accessible to EmuTOS.  however, we allow
-                 * access via XHDI for MiNT's benefit.
+                 * but Linux partitions are not accessible to EmuTOS (nor are
+                 * FAT32 ones unless CONF_WITH_FAT32 is set).  however, we
+                 * allow access via XHDI for MiNT's benefit.
                  */
-                KDEBUG((" %s partition: not yet supported\n",(type==0x83)?"Linux":"FAT32"));
+                KDEBUG((" %s partition\n",(type==0x83)?"Linux":"FAT32"));
                 FALLTHROUGH;
             case 0x01:
             case 0x04:
@@ -776,7 +803,7 @@ static int atari_partition(UWORD unit,LONG *devices_available)
     if (disk_rw(unit, RW_READ, 0, 1, sect))
         return -1;
 
-    KINFO(("%cd%c: ","ashf????"[major>>3],'a'+(major&0x07)));
+    KINFO(("%cd%c: ","ashfr???"[major>>3],'a'+(major&0x07)));
 
 #if CONF_WITH_IDE
     /* IDE drives may be byteswapped if partitioned on foreign hardware */
@@ -976,6 +1003,11 @@ static LONG internal_inquire(UWORD unit, ULONG *blocksize, ULONG *deviceflags, c
         flags = XH_TARGET_REMOVABLE;    /* medium is removable */
         break;
 #endif /* CONF_WITH_SDMMC */
+#if CONF_WITH_RAMDISK
+    case RAMDISK_BUS:
+        ret = ramdisk_ioctl(reldev,GET_DISKNAME,name);
+        break;
+#endif /* CONF_WITH_RAMDISK */
     default:
         ret = EUNDEV;
     }
@@ -1076,6 +1108,13 @@ LONG disk_get_capacity(UWORD unit, ULONG *blocks, ULONG *blocksize)
             return ret;
         break;
 #endif /* CONF_WITH_SDMMC */
+#if CONF_WITH_RAMDISK
+    case RAMDISK_BUS:
+        ret = ramdisk_ioctl(reldev,GET_DISKINFO,info);
+        if (ret < 0)
+            return ret;
+        break;
+#endif /* CONF_WITH_RAMDISK */
     default:
         return EUNDEV;
     }
@@ -1144,6 +1183,11 @@ LONG disk_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf)
         KDEBUG(("sd_rw() returned %ld\n", ret));
         break;
 #endif /* CONF_WITH_SDMMC */
+#if CONF_WITH_RAMDISK
+    case RAMDISK_BUS:
+        ret = ramdisk_rw(rw, sector, count, buf, reldev);
+        break;
+#endif /* CONF_WITH_RAMDISK */
     default:
         ret = EUNDEV;
     }
@@ -1158,6 +1202,12 @@ LONG DMAread(LONG sector, WORD count, UBYTE *buf, WORD major)
     UWORD unit = NUMFLOPPIES + major;
     LONG rc;
 
+#if CONF_WITH_RWQUEUE
+    rc = rwq_sync(unit, sector, count, TRUE);
+    if (rc < 0)
+        return rc;
+#endif
+
     rc = disk_rw(unit, RW_READ, sector, count, buf);
 
     /* TOS invalidates the i-cache here, so be compatible */
@@ -1169,6 +1219,13 @@ LONG DMAread(LONG sector, WORD count, UBYTE *buf, WORD major)
 LONG DMAwrite(LONG sector, WORD count, const UBYTE *buf, WORD major)
 {
     UWORD unit = NUMFLOPPIES + major;
+#if CONF_WITH_RWQUEUE
+    LONG rc;
+
+    rc = rwq_sync(unit, sector, count, TRUE);
+    if (rc < 0)
+        return rc;
+#endif
 
     return disk_rw(unit, RW_WRITE, sector, count, CONST_CAST(UBYTE *, buf));
 }
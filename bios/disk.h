@@ -26,6 +26,7 @@
 #define IS_SCSI_DEVICE(major)   (GET_BUS(major) == SCSI_BUS)
 #define IS_IDE_DEVICE(major)    (GET_BUS(major) == IDE_BUS)
 #define IS_SDMMC_DEVICE(major)  (GET_BUS(major) == SDMMC_BUS)
+#define IS_RAMDISK_DEVICE(major) (GET_BUS(major) == RAMDISK_BUS)
 
 #define GET_UNITNUM(bus,dev)    (NUMFLOPPIES+(DEVICES_PER_BUS*(bus))+dev)
 
@@ -38,6 +39,9 @@
                                 /*   [1] sector size (in bytes)       */
 #define GET_DISKNAME        21  /* get name of specified drive:       */
                                 /* arg -> return data (max 40 chars)  */
+#define GET_XFERSTATS       22  /* get transfer statistics:           */
+                                /* arg -> driver-specific structure   */
+                                /*   (IDE: IDESTATS)                  */
 #define GET_MEDIACHANGE     30  /* return status as per Mediach() call*/
                                 /* arg is NULL                        */
 #define CHECK_DEVICE        40  /* determine if device exists         */
@@ -57,6 +61,7 @@
 #define RW_NOMEDIACH        2
 #define RW_NORETRIES        4
 #define RW_NOTRANSLATE      8
+/* EmuTOS extension: RW_NOCRITIC (64) is in biosext.h, for the BDOS */
 /* EmuTOS extension: Rwabs without byteswap on IDE */
 #define RW_NOBYTESWAP     128
 
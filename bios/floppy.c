@@ -44,6 +44,7 @@
  * - disk initializations: hdv_init, hdv_boot
  * - boot-sector: protobt
  * - boot-sector utilities: intel format words
+ * - track cache
  * - xbios floprd, flopwr, flopver
  * - xbios flopfmt
  * - internal flopio, fropwtrack
@@ -109,6 +110,13 @@ static WORD flopio(UBYTE *buf, WORD rw, WORD dev,
 static WORD flopio_ver(UBYTE *buf, WORD rw, WORD dev,
                    WORD sect, WORD track, WORD side, WORD count);
 
+#if CONF_WITH_FLOPPY_CACHE
+/* track cache */
+static WORD flopcache_io(UBYTE *buf, WORD rw, WORD dev, WORD sect,
+                   WORD track, WORD side, WORD count, WORD spt);
+static void flopcache_discard(WORD dev);
+#endif
+
 /* floppy write track */
 static WORD flopwtrack(UBYTE *buf, WORD dev, WORD track, WORD side,
                     WORD track_size, WORD density);
@@ -300,6 +308,12 @@ static void flop_init(WORD dev)
 
 void flop_hdv_init(void)
 {
+#if CONF_WITH_FLOPPY_CACHE
+    /* programs may call hdv_init again */
+    flopcache_discard(0);
+    flopcache_discard(1);
+#endif
+
     /* set floppy specific stuff */
     fverify = 0xff;
     seekrate = DD_STEPRATE_3MS;
@@ -371,7 +385,7 @@ static void flop_add_drive(WORD dev)
     b->geometry.sides = 1;      /* default geometry of 3.5" 1S DD */
     b->geometry.spt = 9;
     b->unit = dev;
-    b->bpb.recsiz = SECTOR_SIZE;
+    b->xbpb.bpb.recsiz = SECTOR_SIZE;
 
     /* OS variables */
     nflops++;
@@ -424,9 +438,9 @@ void flop_checksum(int floppy, UBYTE *buf)
 }
 
 /*
- * flop_mediach - return mediachange status for floppy
+ * flop_check_change - check for a diskette change
  */
-LONG flop_mediach(WORD dev)
+static LONG flop_check_change(WORD dev)
 {
     struct fat16_bs *bootsec = (struct fat16_bs *) dskbufp;
     struct flop_info *fi;
@@ -520,6 +534,36 @@ LONG flop_mediach(WORD dev)
     return MEDIANOCHANGE;
 }
 
+/*
+ * flop_mediach - return mediachange status for floppy
+ */
+LONG flop_mediach(WORD dev)
+{
+    LONG ret;
+
+    ret = flop_check_change(dev);
+
+#if CONF_WITH_FLOPPY_CACHE
+    /* the cached track may belong to another diskette */
+    if (ret != MEDIANOCHANGE)
+        flopcache_discard(dev);
+#endif
+
+    return ret;
+}
+
+
+/*
+ * the transfers for each track/side go through the track cache if there
+ * is one
+ */
+#if CONF_WITH_FLOPPY_CACHE
+#define flopio_trkside(buf,rw,dev,sect,track,side,count) \
+    flopcache_io(buf,rw,dev,sect,track,side,count,spt)
+#else
+#define flopio_trkside(buf,rw,dev,sect,track,side,count) \
+    flopio_ver(buf,rw,dev,sect,track,side,count)
+#endif
 
 LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
                WORD sides, WORD dev)
@@ -564,7 +608,7 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
         numsecs = spt - start_relsec;
         KDEBUG(("floppy_rw() #1: track=%d, side=%d, start=%d, count=%d\n",
                 track,side,start_relsec+1,numsecs));
-        err = flopio_ver(buf, rw, dev, start_relsec+1, track, side, numsecs);
+        err = flopio_trkside(buf, rw, dev, start_relsec+1, track, side, numsecs);
         if (err)
             return err;
         buf += SECTOR_SIZE * numsecs;
@@ -585,7 +629,7 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
         }
         KDEBUG(("floppy_rw() #2: track=%d, side=%d, start=%d, count=%d\n",
                 track,side,1,spt));
-        err = flopio_ver(buf, rw, dev, 1, track, side, spt);
+        err = flopio_trkside(buf, rw, dev, 1, track, side, spt);
         if (err)
             return err;
         buf += SECTOR_SIZE * spt;
@@ -604,17 +648,159 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
     numsecs = end_relsec - start_relsec + 1;
     KDEBUG(("floppy_rw() #3: track=%d, side=%d, start=%d, count=%d\n",
             track,side,start_relsec+1,numsecs));
-    err = flopio_ver(buf, rw, dev, start_relsec+1, track, side, numsecs);
+    err = flopio_trkside(buf, rw, dev, start_relsec+1, track, side, numsecs);
     if (err)
         return err;
 
     return 0;
 }
 
+
+#if CONF_WITH_FLOPPY_CACHE
+
+/*==== Track cache ========================================================*/
+
+/*
+ * each floppy drive has a buffer in ST-RAM that holds one track/side.
+ * the first access by floppy_rw() to a track/side reads all of it, and
+ * the following reads are served from the buffer.
+ *
+ * the cache is write-through: writes go to the diskette at once, and the
+ * buffer is only updated if they succeed.  so the buffer never holds
+ * anything that is not on the diskette, and it can be discarded at any
+ * time without losing data: when flop_mediach() reports a (possible)
+ * diskette change, when flopvbl() sees an eject, and before Flopwr() and
+ * Flopfmt() modify the diskette behind our back.
+ */
+#define FC_MAXSPT_DD    11      /* largest track/side that can be cached */
+#define FC_MAXSPT_HD    22
+
+struct flop_cache {
+    UBYTE *buf;         /* NULL => no cache for this drive */
+    WORD maxspt;        /* size of buf, in sectors */
+    WORD track;         /* cached track, or -1 if none */
+    WORD side;
+    WORD spt;           /* number of sectors in the cached track/side */
+};
+
+static struct flop_cache fcache[NUMFLOPPIES];
+
+/*
+ * allocate the buffers for the drives that exist
+ *
+ * this is called once by blkdev_init(), after flop_hdv_init()
+ */
+void flopcache_init(void)
+{
+    struct flop_cache *c;
+    WORD dev;
+
+    for (dev = 0, c = fcache; dev < NUMFLOPPIES; dev++, c++) {
+        c->buf = NULL;
+        c->track = -1;
+        if (!units[dev].valid)
+            continue;
+        c->maxspt = (finfo[dev].drive_type == HD_DRIVE) ? FC_MAXSPT_HD : FC_MAXSPT_DD;
+        c->buf = balloc_stram((ULONG)c->maxspt * SECTOR_SIZE, FALSE);
+        KDEBUG(("flopcache_init(): drive %d, %d sectors at %p\n",dev,c->maxspt,c->buf));
+    }
+}
+
+/*
+ * forget the cached track/side
+ */
+static void flopcache_discard(WORD dev)
+{
+    fcache[dev].track = -1;
+}
+
+/*
+ * read or write sectors on one track/side via the cache
+ */
+static WORD flopcache_io(UBYTE *buf, WORD rw, WORD dev, WORD sect,
+                         WORD track, WORD side, WORD count, WORD spt)
+{
+    struct flop_cache *c = &fcache[dev];
+    UBYTE *p;
+    WORD err;
+
+    rw &= RW_RW;
+
+    /*
+     * if the drive has no cache, or the track/side doesn't fit, we
+     * bypass the cache
+     */
+    if (!c->buf || (spt > c->maxspt)) {
+        flopcache_discard(dev);
+        return flopio_ver(buf, rw, dev, sect, track, side, count);
+    }
+
+    p = c->buf + (sect-1) * SECTOR_SIZE;
+
+    /*
+     * writing: the sectors are written at once.  the cached copy is
+     * updated if the write succeeds, and forgotten if it fails.  a
+     * track/side that is written completely becomes the cached one.
+     */
+    if (rw == RW_WRITE) {
+        err = flopio_ver(buf, RW_WRITE, dev, sect, track, side, count);
+        if (err) {
+            if ((c->track == track) && (c->side == side))
+                flopcache_discard(dev);
+            return err;
+        }
+        if ((c->track == track) && (c->side == side) && (c->spt == spt)) {
+            memcpy(p, buf, (ULONG)count * SECTOR_SIZE);
+        } else if (count == spt) {
+            memcpy(c->buf, buf, (ULONG)spt * SECTOR_SIZE);
+            c->track = track;
+            c->side = side;
+            c->spt = spt;
+        }
+        return 0;
+    }
+
+    /*
+     * reading another track/side: get all of it, unless we only need
+     * part of it & reading the rest fails, maybe because of a bad sector.
+     * in that case we just read the requested sectors directly.
+     */
+    if ((c->track != track) || (c->side != side) || (c->spt != spt)) {
+        flopcache_discard(dev);
+        if (count == spt) {
+            err = flopio(buf, RW_READ, dev, 1, track, side, spt);
+            if (err)
+                return err;
+            memcpy(c->buf, buf, (ULONG)spt * SECTOR_SIZE);
+        } else if (flopio(c->buf, RW_READ, dev, 1, track, side, spt) != 0) {
+            KDEBUG(("flopcache_io(): can't read track %d side %d\n",track,side));
+            return flopio_ver(buf, RW_READ, dev, sect, track, side, count);
+        } else {
+            memcpy(buf, p, (ULONG)count * SECTOR_SIZE);
+        }
+        c->track = track;
+        c->side = side;
+        c->spt = spt;
+        return 0;
+    }
+
+    memcpy(buf, p, (ULONG)count * SECTOR_SIZE);
+
+    return 0;
+}
+
+#endif /* CONF_WITH_FLOPPY_CACHE */
+
 #if CONF_WITH_EJECT
 
 void flop_eject(void)
 {
+#if CONF_WITH_FLOPPY_CACHE
+    WORD dev;
+
+    for (dev = 0; dev < NUMFLOPPIES; dev++)
+        flopcache_discard(dev);
+#endif
 }
 
 #endif /* CONF_WITH_EJECT */
@@ -715,6 +901,11 @@ LONG floprd(UBYTE *buf, LONG filler, WORD dev,
 LONG flopwr(const UBYTE *buf, LONG filler, WORD dev,
             WORD sect, WORD track, WORD side, WORD count)
 {
+#if CONF_WITH_FLOPPY_CACHE
+    if (IS_VALID_FLOPPY_DEVICE(dev))
+        flopcache_discard(dev);
+#endif
+
     return flopio(CONST_CAST(UBYTE *, buf), RW_WRITE, dev, sect, track, side, count);
 }
 
@@ -865,6 +1056,10 @@ LONG flopfmt(UBYTE *buf, WORD *skew, WORD dev, WORD spt,
     if (magic != 0x87654321UL)
         return EBADSF;          /* just like TOS4 */
 
+#if CONF_WITH_FLOPPY_CACHE
+    flopcache_discard(dev);
+#endif
+
     if ((spt >= 13) && (spt <= 20)) {
         density = DENSITY_HD;
         track_size = TRACK_SIZE_HD;
@@ -1318,6 +1513,11 @@ void flopvbl(void)
     motor_on = status & FDC_MOTORON;    /* remember for flopcmd()'s use */
 
     wp = status & FDC_WRI_PRO;
+#if CONF_WITH_FLOPPY_CACHE
+    /* diskette removed (or write-protected): forget the track */
+    if (wp && !finfo[n].wpstatus)
+        fcache[n].track = -1;
+#endif
     finfo[n].wpstatus = wp;
     finfo[n].wplatch |= wp;
 
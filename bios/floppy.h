@@ -46,6 +46,10 @@ void flop_checksum(int floppy, UBYTE *buf);
 
 void flopvbl(void);
 
+#if CONF_WITH_FLOPPY_CACHE
+void flopcache_init(void);
+#endif
+
 #endif /* CONF_WITH_FDC */
 
 /* lowlevel floppy_rwabs */
@@ -156,7 +156,7 @@ struct IDE
  * if this is a multiple of the sectors-per-interrupt value supported by
  * the drive(s) in multiple mode.
  */
-#define MAXSECS_PER_IO  32
+#define MAXSECS_PER_IO  128
 
 
 /* interface/device info */
@@ -168,10 +168,12 @@ struct IFINFO {
         UBYTE spi;          /* # sectors transferred between interrupts */
         UBYTE sectors;      /* sectors per track (CHS mode only) */
         UBYTE heads;        /* heads per cylinder (CHS mode only) */
+        UBYTE maxsecs;      /* max # sectors per command (multiple of spi) */
 #if CONF_WITH_SCSI_DRIVER
         UBYTE sense;        /* ATA: current sense condition on device */
         UBYTE packet_size;  /* ATAPI: packet size */
 #endif
+        IDESTATS stats;     /* returned by ide_ioctl(GET_XFERSTATS) */
     } dev[2];
     volatile struct IDE *base_address;
     BOOL twisted_cable;
@@ -283,6 +285,8 @@ static struct {             /* space to build return data for Inquiry */
 /* prototypes */
 static WORD clear_multiple_mode(UWORD ifnum,UWORD dev);
 static void ide_detect_devices(UWORD ifnum);
+static void ide_wait_reset(void);
+static void ide_detect_types(UWORD ifnum);
 static LONG ata_identify(WORD dev);
 static int ide_select_device(volatile struct IDE *interface,UWORD dev);
 static void set_chs_mode(WORD dev,struct IDENTIFY *identify);
@@ -364,7 +368,7 @@ static int ide_interface_is_ghost(WORD ifnum)
     return 0;
 }
 
-/* Enum to capture interface status during ide_interface_exists(). */
+/* Enum to capture interface status during ide_probe_interfaces(). */
 enum ide_if_status
 {
     IDE_IF_NOTCHECKED,
@@ -373,10 +377,41 @@ enum ide_if_status
     IDE_IF_PRESENT
 };
 
+/* state of an interface during ide_probe_interfaces() */
+struct IFPROBE
+{
+    enum ide_if_status regular;
+    enum ide_if_status twisted;
+    BOOL allow_twisted;
+};
+
+/*
+ * prepare to check if a specific interface really exists
+ */
+static void ide_interface_start(WORD ifnum, struct IFPROBE *probe)
+{
+    volatile struct IDE *regular_iface = ifinfo[ifnum].base_address;
+    volatile struct IDE *twisted_iface = (volatile struct IDE *)(((ULONG)ifinfo[ifnum].base_address)-1);
+
+    probe->regular = IDE_IF_NOTCHECKED;
+    probe->twisted = IDE_IF_NOTPRESENT;
+    probe->allow_twisted = check_read_byte((long)&twisted_iface->control);
+
+    IDE_WRITE_CONTROL(regular_iface,IDE_CONTROL_nIEN);/* no interrupts please */
+    if (probe->allow_twisted) {
+        /* Registers for potential "twisted" interface are accessible. */
+        IDE_WRITE_CONTROL(twisted_iface,IDE_CONTROL_nIEN);/* no interrupts please */
+        probe->twisted = IDE_IF_NOTCHECKED;
+    }
+}
+
 /*
  * determine if a specific interface really exists, allowing for
  * incomplete hardware address decoding and twisted cables
  *
+ * this is called repeatedly (for all interfaces in turn) until it
+ * returns TRUE, or the common timeout expires
+ *
  * method:
  * as soon as the BSY bit on an interface is low:
  *    write a magic number (dependent on the interface number) to
@@ -389,71 +424,91 @@ enum ide_if_status
  *       => ghost interface
  *    c. if the magic number is not read back correctly
  *       => no device present
- * break if...
+ * return TRUE if...
  *    a. a device is found
  *    b. no device is found on both regular and twisted interfaces
- *    c. a timeout occurs, i.e., both interfaces stayed BSY
  */
-static int ide_interface_exists(WORD ifnum, LONG timeout)
+static BOOL ide_interface_poll(WORD ifnum, struct IFPROBE *probe)
 {
     volatile struct IDE *regular_iface = ifinfo[ifnum].base_address;
     volatile struct IDE *twisted_iface = (volatile struct IDE *)(((ULONG)ifinfo[ifnum].base_address)-1);
-    enum ide_if_status regular_iface_status = IDE_IF_NOTCHECKED;
-    enum ide_if_status twisted_iface_status = IDE_IF_NOTPRESENT;
-    BOOL allow_twisted = check_read_byte((long)&twisted_iface->control);
 
-    IDE_WRITE_CONTROL(regular_iface,IDE_CONTROL_nIEN);/* no interrupts please */
-    if (allow_twisted) {
-        /* Registers for potential "twisted" interface are accessible. */
-        IDE_WRITE_CONTROL(twisted_iface,IDE_CONTROL_nIEN);/* no interrupts please */
-        twisted_iface_status = IDE_IF_NOTCHECKED;
+    /* Check BSY on regular interface. */
+    if ((IDE_READ_ALT_STATUS(regular_iface) & IDE_STATUS_BSY) == 0) {
+        /* Check it exists by setting and reading back magic number. */
+        KDEBUG(("checking ide interface %d\n", ifnum));
+        set_interface_magic(regular_iface, ifnum);
+        if (check_interface_magic(regular_iface, ifnum)) {
+            ifinfo[ifnum].twisted_cable = FALSE;
+            probe->regular = IDE_IF_PRESENT;
+            /* Check that it is not a ghost interface. */
+            if ((ifnum > 0) && ide_interface_is_ghost(ifnum)) {
+                probe->regular = IDE_IF_ISGHOST;
+            }
+            return TRUE;
+        } else {
+            probe->regular = IDE_IF_NOTPRESENT;
+        }
     }
 
-    DELAY_400NS;
-    do {
-        /* Check BSY on regular interface. */
-        if ((IDE_READ_ALT_STATUS(regular_iface) & IDE_STATUS_BSY) == 0) {
-            /* Check it exists by setting and reading back magic number. */
-            KDEBUG(("checking ide interface %d\n", ifnum));
-            set_interface_magic(regular_iface, ifnum);
-            if (check_interface_magic(regular_iface, ifnum)) {
-                ifinfo[ifnum].twisted_cable = FALSE;
-                regular_iface_status = IDE_IF_PRESENT;
-                /* Check that it is not a ghost interface. */
-                if ((ifnum > 0) && ide_interface_is_ghost(ifnum)) {
-                    regular_iface_status = IDE_IF_ISGHOST;
-                }
-                break;
-            } else {
-                regular_iface_status = IDE_IF_NOTPRESENT;
+    /* Check BSY on twisted interface. */
+    if (probe->allow_twisted && ((IDE_READ_ALT_STATUS(twisted_iface) & IDE_STATUS_BSY) == 0)) {
+        /* Check it exists by setting and reading back magic number. */
+        KDEBUG(("checking ide interface %d with twisted cable\n", ifnum));
+        set_interface_magic(twisted_iface, ifnum);
+        if (check_interface_magic(twisted_iface, ifnum)) {
+            ifinfo[ifnum].base_address = twisted_iface;
+            ifinfo[ifnum].twisted_cable = TRUE;
+            probe->twisted = IDE_IF_PRESENT;
+            /* Check that it is not a ghost interface. */
+            if ((ifnum > 0) && ide_interface_is_ghost(ifnum)) {
+                probe->twisted = IDE_IF_ISGHOST;
             }
+            return TRUE;
+        } else {
+            probe->twisted = IDE_IF_NOTPRESENT;
         }
+    }
 
-        /* Check BSY on twisted interface. */
-        if (allow_twisted && ((IDE_READ_ALT_STATUS(twisted_iface) & IDE_STATUS_BSY) == 0)) {
-            /* Check it exists by setting and reading back magic number. */
-            KDEBUG(("checking ide interface %d with twisted cable\n", ifnum));
-            set_interface_magic(twisted_iface, ifnum);
-            if (check_interface_magic(twisted_iface, ifnum)) {
-                ifinfo[ifnum].base_address = twisted_iface;
-                ifinfo[ifnum].twisted_cable = TRUE;
-                twisted_iface_status = IDE_IF_PRESENT;
-                /* Check that it is not a ghost interface. */
-                if ((ifnum > 0) && ide_interface_is_ghost(ifnum)) {
-                    twisted_iface_status = IDE_IF_ISGHOST;
-                }
-                break;
-            } else {
-                twisted_iface_status = IDE_IF_NOTPRESENT;
-            }
+    return (probe->regular != IDE_IF_NOTCHECKED) && (probe->twisted != IDE_IF_NOTCHECKED);
+}
+
+/*
+ * check which of the interfaces in has_ide really exist
+ *
+ * rather than waiting for each interface in turn, we poll all of them
+ * until they have all been checked, or until a single timeout expires.
+ * the interfaces are always checked in ascending order, so that a ghost
+ * is always checked after the interface that it is a ghost of.
+ */
+static void ide_probe_interfaces(void)
+{
+    struct IFPROBE probe[NUM_IDE_INTERFACES];
+    LONG timeout = hz_200 + LONG_TIMEOUT;
+    int i, bitmask, pending = 0;
+
+    for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1) {
+        if (has_ide&bitmask) {
+            ide_interface_start(i, &probe[i]);
+            pending |= bitmask;
         }
-    } while ((hz_200 < timeout) &&
-             ((regular_iface_status == IDE_IF_NOTCHECKED) || (twisted_iface_status == IDE_IF_NOTCHECKED)));
+    }
 
-    int rc = (regular_iface_status == IDE_IF_PRESENT) || (twisted_iface_status == IDE_IF_PRESENT);
-    KDEBUG(("ide interface %d %s %s\n",ifnum,rc?"exists":"not present",ifinfo[ifnum].twisted_cable?"(twisted cable)":""));
+    DELAY_400NS;
+    do {
+        for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1) {
+            if (!(pending&bitmask) || !ide_interface_poll(i, &probe[i]))
+                continue;
+            pending &= ~bitmask;
+            if ((probe[i].regular != IDE_IF_PRESENT) && (probe[i].twisted != IDE_IF_PRESENT))
+                has_ide &= ~bitmask;
+            KDEBUG(("ide interface %d %s %s\n",i,(has_ide&bitmask)?"exists":"not present",
+                    ifinfo[i].twisted_cable?"(twisted cable)":""));
+        }
+    } while (pending && (hz_200 < timeout));
 
-    return rc;
+    /* the interfaces that are still busy don't exist */
+    has_ide &= ~pending;
 }
 #endif
 
@@ -518,24 +573,29 @@ void ide_init(void)
 
 #if CONF_ATARI_HARDWARE
     /* Reject 'ghost' interfaces & detect twisted cables.
-     * We wait a max time for BSY to drop on all IDE interface
+     * We wait a max time for BSY to drop on all IDE interfaces
      * since this is called during initialisation, which can be
      * invoked by power-on/reset.
      */
-    LONG timeout = hz_200 + LONG_TIMEOUT;
-    for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1)
-        if (has_ide&bitmask)
-            if (!ide_interface_exists(i, timeout))
-                has_ide &= ~bitmask;
+    ide_probe_interfaces();
 
     KDEBUG(("ide_init(): has_ide = 0x%02x\n",has_ide));
 #endif
 
-    /* detect devices */
+    /*
+     * detect devices: all the interfaces are reset together, and we
+     * then wait for all of them with a single timeout
+     */
     for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1)
         if (has_ide&bitmask)
             ide_detect_devices(i);
 
+    ide_wait_reset();
+
+    for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1)
+        if (has_ide&bitmask)
+            ide_detect_types(i);
+
     /* set multiple mode for all devices that we have info for */
     for (i = 0; i < DEVICES_PER_BUS; i++)
         if (ata_identify(i) == 0) {
@@ -582,20 +642,11 @@ static UWORD ide_device_type(WORD dev)
  * the following routines for device type detection are adapted
  * from Hale Landis's public domain ATA driver, MINDRVR.
  */
-static int wait_for_not_BSY_and_DRDY(volatile struct IDE *interface,LONG timeout)
-{
-    LONG next = hz_200 + timeout;
-
-    DELAY_400NS;
-    while(hz_200 < next) {
-        if ((IDE_READ_ALT_STATUS(interface) & (IDE_STATUS_BSY|IDE_STATUS_DRDY)) == IDE_STATUS_DRDY)
-            return 0;
-    }
-
-    KDEBUG(("Timeout in wait_for_not_BSY_and_DRDY(%p,%ld)\n",interface,timeout));
-    return 1;
-}
 
+/*
+ * start a soft reset of the specified interface: ide_wait_reset() waits
+ * for it to complete
+ */
 static void ide_reset(UWORD ifnum)
 {
     struct IFINFO *info = ifinfo + ifnum;
@@ -605,12 +656,42 @@ static void ide_reset(UWORD ifnum)
     IDE_WRITE_CONTROL(interface,(IDE_CONTROL_SRST|IDE_CONTROL_nIEN));
     DELAY_5US;
     IDE_WRITE_CONTROL(interface,IDE_CONTROL_nIEN);
+}
+
+/*
+ * wait for the interfaces that have at least one device to complete
+ * their soft reset, i.e. to clear BSY and set DRDY.  the interfaces are
+ * polled together, with a single timeout.
+ */
+static void ide_wait_reset(void)
+{
+    LONG next = hz_200 + LONG_TIMEOUT;
+    int i, bitmask, pending = 0;
+
+    for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1) {
+        if (!(has_ide&bitmask))
+            continue;
+        if ((ifinfo[i].dev[0].type != DEVTYPE_NONE)
+         || (ifinfo[i].dev[1].type != DEVTYPE_NONE))
+            pending |= bitmask;
+    }
+
     DELAY_400NS;
+    while (pending && (hz_200 < next)) {
+        for (i = 0, bitmask = 1; i < NUM_IDE_INTERFACES; i++, bitmask <<= 1) {
+            volatile struct IDE *interface = ifinfo[i].base_address;
+
+            MAYBE_UNUSED(interface);
+
+            if (!(pending&bitmask))
+                continue;
+            if ((IDE_READ_ALT_STATUS(interface) & (IDE_STATUS_BSY|IDE_STATUS_DRDY)) == IDE_STATUS_DRDY)
+                pending &= ~bitmask;
+        }
+    }
 
-    /* if at least one device exists, wait for it to clear BSY and set DRDY */
-    if ((info->dev[0].type != DEVTYPE_NONE)
-     || (info->dev[1].type != DEVTYPE_NONE))
-        wait_for_not_BSY_and_DRDY(interface,LONG_TIMEOUT);
+    if (pending)
+        KDEBUG(("Timeout in ide_wait_reset(): interfaces 0x%02x\n",pending));
 }
 
 static UBYTE ide_decode_type(UBYTE status,UWORD signature)
@@ -635,8 +716,6 @@ static void ide_detect_devices(UWORD ifnum)
 {
     volatile struct IDE *interface = ifinfo[ifnum].base_address;
     struct IFINFO *info = ifinfo + ifnum;
-    UBYTE status;
-    UWORD signature;
     int i;
 
     MAYBE_UNUSED(interface);
@@ -663,14 +742,30 @@ static void ide_detect_devices(UWORD ifnum)
             info->dev[i].type = DEVTYPE_NONE;
         info->dev[i].options = 0;
         info->dev[i].spi = 0;   /* changed if using READ/WRITE MULTIPLE */
+        info->dev[i].maxsecs = MAXSECS_PER_IO;
+        bzero(&info->dev[i].stats, sizeof(IDESTATS));
 #if CONF_WITH_SCSI_DRIVER
         info->dev[i].sense = 0;
 #endif
     }
 
-    /* recheck after soft reset, also detect ata/atapi */
+    /* recheck after soft reset (see ide_detect_types()) */
     ide_select_device(interface,0);
     ide_reset(ifnum);
+}
+
+/*
+ * after the soft reset, recheck the devices & detect ata/atapi
+ */
+static void ide_detect_types(UWORD ifnum)
+{
+    volatile struct IDE *interface = ifinfo[ifnum].base_address;
+    struct IFINFO *info = ifinfo + ifnum;
+    UBYTE status;
+    UWORD signature;
+    int i;
+
+    MAYBE_UNUSED(interface);
 
     for (i = 0; i < 2; i++) {
         ide_select_device(interface,i);
@@ -761,6 +856,7 @@ static void set_start_count(volatile struct IDE *interface,UBYTE sector,UBYTE co
     IDE_WRITE_SECTOR_NUMBER_SECTOR_COUNT(interface,sector,count);
 }
 
+#if CONF_WITH_SCSI_DRIVER
 /*
  * set cylinder high / cylinder low IDE registers
  */
@@ -778,9 +874,16 @@ static void set_command_head(volatile struct IDE *interface,UBYTE cmd,UBYTE head
     wait_for_not_BSY_not_DRQ(interface,SHORT_TIMEOUT);
     IDE_WRITE_COMMAND_HEAD(interface,cmd,head);
 }
+#endif
 
 /*
  * set device / command / sector start / count / LBA mode in IDE registers
+ *
+ * the device has already been selected by the caller.  since writing the
+ * command block registers does not make the device busy, we wait once
+ * for BSY & DRQ to clear and then load all the registers back-to-back:
+ * when called for the next chunk of a multi-command transfer, this wait
+ * overlaps with the final status check of the previous command.
  */
 static void ide_rw_start(UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UBYTE cmd)
 {
@@ -791,6 +894,8 @@ static void ide_rw_start(UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UBYTE cm
     KDEBUG(("ide_rw_start(%p, %u, %u, %lu, %u, 0x%02x)\n",
             interface, ifnum, dev, sector, count, cmd));
 
+    wait_for_not_BSY_not_DRQ(interface,SHORT_TIMEOUT);
+
     /*
      * handle CHS device
      */
@@ -805,9 +910,9 @@ static void ide_rw_start(UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UBYTE cm
 
         KDEBUG((" CHS mode: %u/%u/%u\n",cylnum,headnum,secnum));
 
-        set_start_count(interface,secnum,LOBYTE(count));
-        set_cylinder(interface,cylnum);
-        set_command_head(interface,cmd,IDE_MODE_CHS|IDE_DEVICE(dev)|headnum);
+        IDE_WRITE_SECTOR_NUMBER_SECTOR_COUNT(interface,secnum,LOBYTE(count));
+        IDE_WRITE_CYLINDER_HIGH_CYLINDER_LOW(interface,cylnum);
+        IDE_WRITE_COMMAND_HEAD(interface,cmd,IDE_MODE_CHS|IDE_DEVICE(dev)|headnum);
         return;
     }
 
@@ -818,8 +923,8 @@ static void ide_rw_start(UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UBYTE cm
         cmd == IDE_CMD_WRITE_SECTOR_EX ||
         cmd == IDE_CMD_READ_MULTIPLE_EX ||
         cmd == IDE_CMD_WRITE_MULTIPLE_EX) {
-        set_start_count(interface,(sector>>24),(count>>8));
-        set_start_count(interface,(sector),(count));
+        IDE_WRITE_SECTOR_NUMBER_SECTOR_COUNT(interface,(UBYTE)(sector>>24),(UBYTE)(count>>8));
+        IDE_WRITE_SECTOR_NUMBER_SECTOR_COUNT(interface,(UBYTE)sector,(UBYTE)count);
 
         /*
          * We should do this, but for now we only support 2^32
@@ -827,16 +932,16 @@ static void ide_rw_start(UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UBYTE cm
          * ULLONG for sector to support 2^48 disk sizes.
          * Additionally, XHDI, etc would need extensions.
          *
-         *   set_cylinder(interface,(UWORD)((sector & 0xffff00000000UL) >> 32));
+         *   IDE_WRITE_CYLINDER_HIGH_CYLINDER_LOW(interface,(UWORD)((sector & 0xffff00000000UL) >> 32));
          */
-        set_cylinder(interface,0);
+        IDE_WRITE_CYLINDER_HIGH_CYLINDER_LOW(interface,0);
 
-        set_cylinder(interface,(UWORD)((sector & 0xffff00) >> 8));
-        set_command_head(interface,cmd,IDE_MODE_LBA|IDE_DEVICE(dev));
+        IDE_WRITE_CYLINDER_HIGH_CYLINDER_LOW(interface,(UWORD)((sector & 0xffff00) >> 8));
+        IDE_WRITE_COMMAND_HEAD(interface,cmd,IDE_MODE_LBA|IDE_DEVICE(dev));
     } else {
-        set_start_count(interface,LOBYTE(sector),LOBYTE(count));
-        set_cylinder(interface,(UWORD)((sector & 0xffff00) >> 8));
-        set_command_head(interface,cmd,IDE_MODE_LBA|IDE_DEVICE(dev)|(UBYTE)((sector>>24)&0x0f));
+        IDE_WRITE_SECTOR_NUMBER_SECTOR_COUNT(interface,LOBYTE(sector),LOBYTE(count));
+        IDE_WRITE_CYLINDER_HIGH_CYLINDER_LOW(interface,(UWORD)((sector & 0xffff00) >> 8));
+        IDE_WRITE_COMMAND_HEAD(interface,cmd,IDE_MODE_LBA|IDE_DEVICE(dev)|(UBYTE)((sector>>24)&0x0f));
     }
 }
 
@@ -1248,9 +1353,10 @@ LONG ide_rw(WORD rw,ULONG sector,UWORD count,UBYTE *buf,WORD dev,BOOL need_bytes
 {
     UBYTE *p;
     UWORD ifnum;
-    WORD maxsecs_per_io = MAXSECS_PER_IO;
+    WORD maxsecs_per_io;
     BOOL use_tmpbuf = FALSE;
-    LONG ret;
+    IDESTATS *stats;
+    LONG start, ret;
 
     if (ide_device_type(dev) != DEVTYPE_ATA)
         return EUNDEV;
@@ -1260,6 +1366,9 @@ LONG ide_rw(WORD rw,ULONG sector,UWORD count,UBYTE *buf,WORD dev,BOOL need_bytes
 
     rw &= RW_RW;    /* we just care about read or write for now */
 
+    maxsecs_per_io = ifinfo[ifnum].dev[dev].maxsecs;
+    stats = &ifinfo[ifnum].dev[dev].stats;
+
     /*
      * because ide_read()/ide_write() access the buffer with word (or long)
      * moves, we must use an intermediate buffer if the user buffer is not
@@ -1272,6 +1381,8 @@ LONG ide_rw(WORD rw,ULONG sector,UWORD count,UBYTE *buf,WORD dev,BOOL need_bytes
         use_tmpbuf = TRUE;
     }
 
+    start = hz_200;
+
     while (count > 0)
     {
         UWORD numsecs;
@@ -1287,11 +1398,21 @@ LONG ide_rw(WORD rw,ULONG sector,UWORD count,UBYTE *buf,WORD dev,BOOL need_bytes
         if (ret < 0) {
             KDEBUG(("ide_rw(%d,%d,%d,%lu,%u,%p,%d) ret=%ld\n",
                     rw,ifnum,dev,sector,numsecs,p,need_byteswap,ret));
+            stats->errors++;
             if (clear_multiple_mode(ifnum,dev)) /* retry after multiple mode reset ? */
                 continue;                       /* yes, do so                        */
+            stats->ticks += hz_200 - start;
             return ret;
         }
 
+        if (rw) {
+            stats->writes++;
+            stats->wsectors += numsecs;
+        } else {
+            stats->reads++;
+            stats->rsectors += numsecs;
+        }
+
         if (!rw && use_tmpbuf)
             memcpy(buf,p,numsecs*SECTOR_SIZE);
 
@@ -1300,6 +1421,8 @@ LONG ide_rw(WORD rw,ULONG sector,UWORD count,UBYTE *buf,WORD dev,BOOL need_bytes
         count -= numsecs;
     }
 
+    stats->ticks += hz_200 - start;
+
     return E_OK;
 }
 
@@ -1376,10 +1499,17 @@ static WORD clear_multiple_mode(UWORD ifnum,UWORD dev)
     return 1;
 }
 
+/*
+ * enable READ/WRITE MULTIPLE with the largest DRQ block size that the
+ * device accepts.  we start with the maximum reported by IDENTIFY DEVICE;
+ * since some devices reject values that are not a power of two (or are
+ * simply buggy), we then fall back to successively smaller powers of two.
+ */
 static void set_multiple_mode(WORD dev,UWORD multi_io)
 {
-    UWORD ifnum;
+    UWORD ifnum, n;
     UBYTE spi;
+    struct IFINFO_DEV *info;
 
     if (!(multi_io & 0x8000))
         return;
@@ -1391,13 +1521,25 @@ static void set_multiple_mode(WORD dev,UWORD multi_io)
     ifnum = dev / 2;    /* i.e. primary IDE, secondary IDE, ... */
     dev &= 1;           /* 0 or 1 */
 
-    KDEBUG(("Setting spi=%d for ifnum %d dev %d\n",spi,ifnum,dev));
+    while (1) {
+        KDEBUG(("Setting spi=%d for ifnum %d dev %d\n",spi,ifnum,dev));
 
-    if (ide_nodata(IDE_CMD_SET_MULTIPLE_MODE,ifnum,dev,0L,spi))
-        return;         /* command failed */
+        if (ide_nodata(IDE_CMD_SET_MULTIPLE_MODE,ifnum,dev,0L,spi) == E_OK)
+            break;
+
+        for (n = 2; n*2 < spi; n *= 2)
+            ;
+        if (n >= spi)
+            return;     /* command failed even for 2 sectors */
+        spi = n;
+    }
+
+    info = &ifinfo[ifnum].dev[dev];
+    info->options |= MULTIPLE_MODE_ACTIVE;
+    info->spi = spi;
 
-    ifinfo[ifnum].dev[dev].options |= MULTIPLE_MODE_ACTIVE;
-    ifinfo[ifnum].dev[dev].spi = spi;
+    /* each command should transfer a whole number of DRQ blocks */
+    info->maxsecs = (spi > MAXSECS_PER_IO) ? spi : MAXSECS_PER_IO - (MAXSECS_PER_IO % spi);
 }
 
 static LONG ata_identify(WORD dev)
@@ -1470,6 +1612,16 @@ LONG ide_ioctl(WORD dev,UWORD ctrl,void *arg)
     case GET_MEDIACHANGE:
         ret = MEDIANOCHANGE;
         break;
+    case GET_XFERSTATS:
+        if (ide_device_type(dev) == DEVTYPE_ATA) {
+            struct IFINFO_DEV *devinfo = &ifinfo[dev/2].dev[dev&1];
+
+            devinfo->stats.spi = (devinfo->options & MULTIPLE_MODE_ACTIVE) ? devinfo->spi : 1;
+            devinfo->stats.maxsecs = devinfo->maxsecs;
+            memcpy(arg,&devinfo->stats,sizeof(IDESTATS));
+            ret = E_OK;
+        } else ret = EUNDEV;
+        break;
 #if CONF_WITH_SCSI_DRIVER
     case CHECK_DEVICE:
         switch(ide_device_type(dev)) {
@@ -15,6 +15,21 @@
 
 #if CONF_WITH_IDE
 
+/*
+ * per-device transfer statistics, returned by ide_ioctl(GET_XFERSTATS)
+ */
+typedef struct
+{
+    ULONG reads;                    /* read commands issued */
+    ULONG rsectors;                 /* sectors read */
+    ULONG writes;                   /* write commands issued */
+    ULONG wsectors;                 /* sectors written */
+    ULONG errors;                   /* failed commands */
+    ULONG ticks;                    /* time spent in ide_rw() (200Hz ticks) */
+    UWORD spi;                      /* sectors per DRQ block (1 => single) */
+    UWORD maxsecs;                  /* max sectors per command */
+} IDESTATS;
+
 BOOL detect_ide(void);
 void ide_init(void);
 LONG ide_ioctl(WORD dev, UWORD ctrl, void *arg);
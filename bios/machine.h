@@ -38,8 +38,11 @@
 #define SCSI_BUS            1
 #define IDE_BUS             2
 #define SDMMC_BUS           3
+#define RAMDISK_BUS         4       /* EmuTOS pseudo-bus for the RAM disk */
 
-#if CONF_WITH_SDMMC
+#if CONF_WITH_RAMDISK
+# define MAX_BUS            RAMDISK_BUS
+#elif CONF_WITH_SDMMC
 # define MAX_BUS            SDMMC_BUS
 #elif CONF_WITH_IDE
 # define MAX_BUS            IDE_BUS
@@ -19,6 +19,7 @@
 #include "cookie.h"
 #include "biosext.h"    /* for cache control routines */
 #include "bios.h"
+#include "ramdisk.h"
 #include "vectors.h"
 #include "../bdos/bdosstub.h"
 #include "string.h"
@@ -33,9 +34,14 @@ UBYTE meminit_flags;
 void altram_init(void)
 {
 #if CONF_WITH_STATIC_ALT_RAM && defined(STATIC_ALT_RAM_SIZE)
+    LONG size = STATIC_ALT_RAM_SIZE;
+
+# if CONF_WITH_RAMDISK
+    size -= ramdisk_altram;         /* the RAM disk is at the top */
+# endif
     KDEBUG(("xmaddalt() static adr=%p size=%ld\n",
-        (UBYTE *)STATIC_ALT_RAM_ADDRESS, STATIC_ALT_RAM_SIZE));
-    xmaddalt((UBYTE *)STATIC_ALT_RAM_ADDRESS, STATIC_ALT_RAM_SIZE);
+        (UBYTE *)STATIC_ALT_RAM_ADDRESS, size));
+    xmaddalt((UBYTE *)STATIC_ALT_RAM_ADDRESS, size);
     return;
 #endif
 }
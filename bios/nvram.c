@@ -15,6 +15,7 @@
 #include "machine.h"
 #include "vectors.h"
 #include "nvram.h"
+#include "biosext.h"
 #include "biosmem.h"
 
 #if CONF_WITH_NVRAM
@@ -19,8 +19,6 @@ void detect_nvram(void);
 UBYTE get_nvram_rtc(int index);
 void set_nvram_rtc(int index, int data);
 
-/* XBios function */
-
-WORD nvmaccess(WORD type, WORD start, WORD count, UBYTE *buffer);
+/* the XBios function nvmaccess() is declared in biosext.h */
 
 #endif  /* CONF_WITH_NVRAM */
@@ -0,0 +1,295 @@
+/*
+ * ramdisk.c - RAM disk driver
+ *
+ * Copyright (C) 2026 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+/*
+ * The RAM disk is a single unit on its own pseudo-bus (RAMDISK_BUS), so
+ * that it is handled by disk.c like any other hard disk unit: it gets a
+ * drive letter after the real hard disks and is visible via XHDI.
+ *
+ * Its size (in Kbytes) is taken from the first of the following that is
+ * set: the ramtos boot parameter 'ramdisk_kbytes', the NVRAM, or
+ * CONF_RAMDISK_SIZE.  The memory comes from the top of the static Alt-RAM
+ * if there is one, otherwise from the top of ST-RAM.
+ *
+ * The unit is formatted without partitions, like a floppy, using the
+ * largest cluster size that is reasonable.  If requested, the contents
+ * are kept across a warm reset: a small header in front of the data
+ * records where the disk was, and it is only reused if the disk is at
+ * the same place with the same size.
+ */
+
+/* #define ENABLE_KDEBUG */
+
+#include "emutos.h"
+#include "disk.h"
+#include "blkdev.h"
+#include "gemerror.h"
+#include "machine.h"
+#include "memory.h"
+#include "biosext.h"
+#include "bootparams.h"
+#include "ramdisk.h"
+#include "string.h"
+#include "tosvars.h"
+
+#if CONF_WITH_RAMDISK
+
+/*
+ * NVRAM byte used for the RAM disk configuration:
+ *  bit 7       1 => the other bits are valid
+ *  bit 6       1 => keep the contents across a warm reset
+ *  bits 0-5    size in units of 512 Kbytes (0 => no RAM disk)
+ */
+#define NVRAM_RAMDISK   18
+#define NVRAM_RD_VALID  0x80
+#define NVRAM_RD_KEEP   0x40
+#define NVRAM_RD_SIZE   0x3f
+#define NVRAM_RD_UNIT   512L            /* in Kbytes */
+
+#define RAMDISK_MAGIC   0x52414d44UL    /* 'RAMD' */
+#define RAMDISK_MIN     64L             /* minimum size in Kbytes */
+
+#define RD_CLUSTER_SIZE 8               /* sectors per cluster (4K clusters) */
+#define RD_ROOT_ENTRIES 256             /* root directory entries */
+
+/*
+ * header at the start of the allocated memory
+ */
+typedef struct {
+    ULONG magic;        /* RAMDISK_MAGIC */
+    ULONG sectors;      /* size of the disk */
+    UBYTE *data;        /* start of sector 0 */
+    ULONG check;        /* sum of the above */
+} RDHEADER;
+
+ULONG ramdisk_altram;           /* used by altram_init() */
+
+static UBYTE *rd_data;          /* NULL if no RAM disk */
+static ULONG rd_sectors;
+
+
+/*
+ * store a little-endian word in a boot sector
+ */
+static void setiword(UBYTE *addr, UWORD value)
+{
+    addr[0] = LOBYTE(value);
+    addr[1] = HIBYTE(value);
+}
+
+/*
+ * get the requested size in Kbytes, and whether to keep the contents
+ */
+static ULONG ramdisk_size(BOOL *keep)
+{
+    ULONG size = CONF_RAMDISK_SIZE;
+#if CONF_WITH_NVRAM
+    UBYTE temp;
+#endif
+
+    *keep = CONF_RAMDISK_KEEP;
+
+#if CONF_WITH_NVRAM
+    if (nvmaccess(0, NVRAM_RAMDISK, 1, &temp) == 0)
+    {
+        if (temp & NVRAM_RD_VALID)
+        {
+            size = (temp & NVRAM_RD_SIZE) * NVRAM_RD_UNIT;
+            *keep = (temp & NVRAM_RD_KEEP) ? TRUE : FALSE;
+        }
+    }
+#endif
+
+#if EMUTOS_LIVES_IN_RAM
+    if (ramdisk_kbytes != RAMDISK_KBYTES_UNSET)
+        size = ramdisk_kbytes;
+#endif
+
+    return size;
+}
+
+/*
+ * build an empty FAT12/FAT16 filesystem in the RAM disk
+ */
+static void ramdisk_format(void)
+{
+    struct fat16_bs *bs = (struct fat16_bs *)rd_data;
+    ULONG clusters, spf;
+    UWORD nfats, rootsecs;
+    UBYTE *fat;
+    int i;
+
+    nfats = CONF_WITH_1FAT_SUPPORT ? 1 : 2;
+    rootsecs = RD_ROOT_ENTRIES * 32 / SECTOR_SIZE;
+
+    /*
+     * determine FAT size: start by assuming FAT16 and one FAT sector,
+     * then iterate (this converges in a couple of passes)
+     */
+    for (spf = 1; ; spf++)
+    {
+        clusters = (rd_sectors - 1 - nfats*spf - rootsecs) / RD_CLUSTER_SIZE;
+        if (clusters <= MAX_FAT12_CLUSTERS)
+        {
+            if ((clusters+2)*3/2 <= spf*SECTOR_SIZE)
+                break;
+        }
+        else if ((clusters+2)*2 <= spf*SECTOR_SIZE)
+            break;
+    }
+
+    bzero(rd_data, (1 + nfats*spf + rootsecs) * SECTOR_SIZE);
+
+    bs->bra[0] = 0xe9;          /* not executable: checksum is not 0x1234 */
+    memcpy(bs->loader, "EmuTOS", 6);
+    setiword(bs->bps, SECTOR_SIZE);
+    bs->spc = RD_CLUSTER_SIZE;
+    setiword(bs->res, 1);
+    bs->fat = nfats;
+    setiword(bs->dir, RD_ROOT_ENTRIES);
+    setiword(bs->sec, rd_sectors);
+    bs->media = 0xf8;
+    setiword(bs->spf, spf);
+    setiword(bs->spt, 32);
+    setiword(bs->sides, 1);
+    bs->ext = 0x29;
+    memcpy(bs->label, "RAMDISK    ", 11);
+    memcpy(bs->fstype, (clusters <= MAX_FAT12_CLUSTERS) ? "FAT12   " : "FAT16   ", 8);
+    bs->cksum[0] = 0x55;        /* so check_for_no_partitions() is used */
+    bs->cksum[1] = 0xaa;
+
+    /* the first two FAT entries contain the media byte & end-of-chain */
+    for (i = 0, fat = rd_data + SECTOR_SIZE; i < nfats; i++, fat += spf*SECTOR_SIZE)
+    {
+        fat[0] = 0xf8;
+        fat[1] = 0xff;
+        fat[2] = 0xff;
+        if (clusters > MAX_FAT12_CLUSTERS)
+            fat[3] = 0xff;
+    }
+
+    KDEBUG(("RAM disk: %lu sectors, %lu clusters, %lu sectors/FAT\n",
+            rd_sectors,clusters,spf));
+}
+
+/*
+ * initialise the RAM disk
+ *
+ * this must be called before altram_init() & before BDOS is initialised
+ */
+void ramdisk_init(void)
+{
+    RDHEADER *hdr;
+    ULONG size, bytes;
+    BOOL keep;
+
+    rd_data = NULL;
+    rd_sectors = 0UL;
+    ramdisk_altram = 0UL;
+
+    size = ramdisk_size(&keep);
+    if (size < RAMDISK_MIN)
+        return;
+    if (size > NVRAM_RD_SIZE * NVRAM_RD_UNIT)   /* keep the sector count in 16 bits */
+        size = NVRAM_RD_SIZE * NVRAM_RD_UNIT;
+
+    bytes = size * 1024UL + sizeof(RDHEADER);
+
+#if CONF_WITH_STATIC_ALT_RAM && defined(STATIC_ALT_RAM_SIZE)
+    if (bytes <= STATIC_ALT_RAM_SIZE / 2)
+    {
+        ramdisk_altram = bytes;
+        hdr = (RDHEADER *)(STATIC_ALT_RAM_ADDRESS + STATIC_ALT_RAM_SIZE - bytes);
+    }
+    else
+#endif
+    {
+        /* don't take more than half of the remaining ST-RAM */
+        if (bytes > (ULONG)(memtop - membot) / 2)
+        {
+            KDEBUG(("RAM disk: not enough memory for %lu Kbytes\n",size));
+            return;
+        }
+        hdr = (RDHEADER *)balloc_stram(bytes, TRUE);
+    }
+
+    rd_data = (UBYTE *)(hdr + 1);
+    rd_sectors = size * (1024 / SECTOR_SIZE);
+
+    if (keep && !FIRST_BOOT && (hdr->magic == RAMDISK_MAGIC)
+     && (hdr->sectors == rd_sectors) && (hdr->data == rd_data)
+     && (hdr->check == hdr->magic + hdr->sectors + (ULONG)hdr->data))
+    {
+        KDEBUG(("RAM disk: keeping contents at %p\n",rd_data));
+        return;
+    }
+
+    ramdisk_format();
+
+    hdr->magic = RAMDISK_MAGIC;
+    hdr->sectors = rd_sectors;
+    hdr->data = rd_data;
+    hdr->check = hdr->magic + hdr->sectors + (ULONG)hdr->data;
+}
+
+/*
+ * perform miscellaneous non-data-transfer functions
+ */
+LONG ramdisk_ioctl(UWORD drv,UWORD ctrl,void *arg)
+{
+    ULONG *info = arg;
+
+    if (drv || !rd_data)
+        return EUNDEV;
+
+    switch(ctrl) {
+    case GET_DISKINFO:
+        info[0] = rd_sectors;
+        info[1] = SECTOR_SIZE;
+        break;
+    case GET_DISKNAME:
+        strcpy(arg, "RAM disk");
+        break;
+    case GET_MEDIACHANGE:
+        return MEDIANOCHANGE;
+    default:
+        return ERR;
+    }
+
+    return 0L;
+}
+
+/*
+ * read/write sectors: this never fails for valid sector numbers, so
+ * blkdev_rwabs() calls it directly for logical requests, without the
+ * usual retry & media change handling
+ */
+LONG ramdisk_rw(WORD rw,LONG sector,LONG count,UBYTE *buf,WORD dev)
+{
+    UBYTE *p;
+    ULONG bytes;
+
+    if (dev || !rd_data)
+        return EUNDEV;
+
+    if ((sector < 0) || (count < 0) || ((ULONG)(sector + count) > rd_sectors))
+        return ESECNF;
+
+    p = rd_data + sector * SECTOR_SIZE;
+    bytes = count * SECTOR_SIZE;
+
+    if (rw & RW_WRITE)
+        memcpy(p, buf, bytes);
+    else
+        memcpy(buf, p, bytes);
+
+    return 0L;
+}
+
+#endif /* CONF_WITH_RAMDISK */
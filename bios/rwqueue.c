@@ -0,0 +1,388 @@
+/*
+ * rwqueue.c - write queue for hard disk Rwabs()
+ *
+ * Copyright (C) 2026 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+/*
+ * Logical Rwabs() writes to hard disk units with 512-byte sectors are
+ * copied into the queue, and Rwabs() returns at once.  The queue is kept
+ * sorted by unit & sector, and a sector that is written again while it
+ * is queued just replaces the queued copy.  When the queue is written
+ * out, the copies are first moved so that their order in the buffer is
+ * the same as in the queue; each run of adjacent sectors is then sent to
+ * disk_rw() as a single transfer.
+ *
+ * The queue is written out:
+ *  . when there is no room for a write
+ *  . when any other transfer overlaps a queued sector: this includes
+ *    physical accesses via Rwabs(), XHDI and DMAread()/DMAwrite()
+ *  . before the media change status of a unit is checked
+ *  . when the BDOS flushes its buffers, e.g. in Fclose()
+ *  . at shutdown, and on request via Sstat()
+ *  . from the VBL interrupt, once the oldest entry is old enough, if
+ *    neither the BDOS nor the BIOS is active
+ *
+ * Write errors are reported via the critical error handler for the
+ * logical drive that the sectors were written to; the sectors are then
+ * lost.  When the queue is written out because it is full, from the VBL
+ * interrupt, or for Rwabs() requests that must not call the critical
+ * error handler (RW_NOCRITIC), the errors belong to someone else: the
+ * queue is left as it is instead, so that it is tried again later, and
+ * the errors are reported by the next flush that may do so.
+ */
+
+/* #define ENABLE_KDEBUG */
+
+#include "emutos.h"
+#include "bdosdefs.h"
+#include "biosext.h"
+#include "blkdev.h"
+#include "disk.h"
+#include "gemerror.h"
+#include "machine.h"
+#include "rwqueue.h"
+#include "string.h"
+#include "tosvars.h"
+
+#if CONF_WITH_RWQUEUE
+
+#define RWQ_SECTORS     CONF_RWQUEUE_SECTORS
+#define RWQ_SHIFT       9                   /* log2(SECTOR_SIZE) */
+#define RWQ_AGE         ((LONG)CONF_RWQUEUE_AGE * CLOCKS_PER_SEC / 1000)
+#define RWQ_MAXWRITE    (RWQ_SECTORS/2)     /* larger writes are not queued */
+
+typedef struct {
+    WORD    unit;       /* physical unit */
+    WORD    dev;        /* logical drive, for the critical error handler */
+    ULONG   sector;     /* physical sector number on the unit */
+    UBYTE   *data;      /* copy of the sector, in rwq_buf */
+} RWQENTRY;
+
+RQSTAT rqstat;
+WORD rwq_errdev;
+
+static RWQENTRY rwq[RWQ_SECTORS];   /* sorted by unit, then sector */
+static WORD rwq_count;              /* also the number of buffer slots in use */
+static UBYTE *rwq_buf;              /* RWQ_SECTORS+1 slots, the last is spare */
+static LONG rwq_time;               /* when the oldest entry was queued */
+
+
+/*
+ * initialise the queue: the buffer is only allocated if there is a
+ * unit that may use it
+ */
+void rwq_init(void)
+{
+    WORD unit;
+
+    rwq_count = 0;
+    rwq_buf = NULL;
+    bzero(&rqstat, sizeof(RQSTAT));
+
+    for (unit = NUMFLOPPIES; unit < UNITSNUM; unit++)
+    {
+        if (!units[unit].valid || (units[unit].psshift != RWQ_SHIFT))
+            continue;
+#if CONF_WITH_RAMDISK
+        if (IS_RAMDISK_DEVICE(unit - NUMFLOPPIES))
+            continue;
+#endif
+        rwq_buf = balloc_stram((RWQ_SECTORS+1)*SECTOR_SIZE, FALSE);
+        rqstat.rq_size = RWQ_SECTORS;
+        KDEBUG(("rwq_init(): %d sectors at %p\n",RWQ_SECTORS,rwq_buf));
+        break;
+    }
+}
+
+/*
+ * return the position of a sector in the queue, or where it would go
+ */
+static WORD rwq_find(WORD unit, ULONG sector)
+{
+    WORD lo, hi, mid;
+    RWQENTRY *e;
+
+    for (lo = 0, hi = rwq_count; lo < hi; )
+    {
+        mid = (lo + hi) / 2;
+        e = &rwq[mid];
+        if ((e->unit < unit) || ((e->unit == unit) && (e->sector < sector)))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/*
+ * return TRUE iff any of the specified sectors are queued
+ */
+static BOOL rwq_overlaps(WORD unit, ULONG sector, LONG count)
+{
+    WORD i = rwq_find(unit, sector);
+
+    return (i < rwq_count) && (rwq[i].unit == unit)
+        && (rwq[i].sector < sector + count);
+}
+
+/*
+ * move the sector copies so that entry 'i' uses slot 'i'
+ *
+ * the slots in use are always the first 'rwq_count' ones, so the slot
+ * that entry 'i' needs is in use by one of the following entries
+ */
+static void rwq_arrange(void)
+{
+    UBYTE *slot, *spare = rwq_buf + RWQ_SECTORS*SECTOR_SIZE;
+    WORD i, j;
+
+    for (i = 0, slot = rwq_buf; i < rwq_count; i++, slot += SECTOR_SIZE)
+    {
+        if (rwq[i].data == slot)
+            continue;
+        for (j = i + 1; rwq[j].data != slot; j++)
+            ;
+        memcpy(spare, slot, SECTOR_SIZE);
+        memcpy(slot, rwq[i].data, SECTOR_SIZE);
+        memcpy(rwq[i].data, spare, SECTOR_SIZE);
+        rwq[j].data = rwq[i].data;
+        rwq[i].data = slot;
+    }
+}
+
+/*
+ * remove the entries for sectors 'first' to 'end'-1 of 'unit' from the
+ * queue, and return how many there were
+ */
+static WORD rwq_remove(WORD unit, ULONG first, ULONG end)
+{
+    UBYTE *last;
+    WORD i, j, n = 0;
+
+    for (i = rwq_find(unit, first); (i < rwq_count) && (rwq[i].unit == unit)
+                                 && (rwq[i].sector < end); n++)
+    {
+        KDEBUG(("rwq_remove(): unit=%d, sector=%lu\n",unit,rwq[i].sector));
+
+        /* free the entry's slot by moving the last slot into it */
+        last = rwq_buf + (rwq_count-1)*SECTOR_SIZE;
+        if (rwq[i].data != last)
+        {
+            for (j = 0; rwq[j].data != last; j++)
+                ;
+            memcpy(rwq[i].data, last, SECTOR_SIZE);
+            rwq[j].data = rwq[i].data;
+        }
+
+        rwq_count--;
+        memmove(&rwq[i], &rwq[i+1], (rwq_count-i)*sizeof(RWQENTRY));
+    }
+
+    return n;
+}
+
+/*
+ * write out the whole queue, merging adjacent sectors
+ *
+ * if 'critic' is FALSE, errors are not reported, and the queue is left
+ * unchanged on error
+ */
+static LONG rwq_writeout(BOOL critic)
+{
+    RWQENTRY *e;
+    LONG ret, err = 0L;
+    WORD i, n, retries;
+
+    if (rwq_count == 0)
+        return 0L;
+
+    rwq_arrange();
+    rqstat.rq_flushes++;
+
+    for (i = 0; i < rwq_count; i += n)
+    {
+        e = &rwq[i];
+        for (n = 1; i + n < rwq_count; n++)
+            if ((rwq[i+n].unit != e->unit) || (rwq[i+n].sector != e->sector + n))
+                break;
+
+        KDEBUG(("rwq_writeout(): unit=%d, sector=%lu, count=%d\n",e->unit,e->sector,n));
+        do {
+            retries = RWABS_RETRIES;
+            do {
+                ret = disk_rw(e->unit, RW_WRITE, e->sector, n, e->data);
+            } while ((ret < 0) && (ret != E_CHNG) && (--retries > 0));
+            if ((ret < 0) && critic)
+                ret = call_etv_critic((WORD)ret, e->dev);
+        } while (ret == CRITIC_RETRY_REQUEST);
+        rqstat.rq_transfers++;
+
+        if (ret < 0)
+        {
+            rqstat.rq_errors++;
+            if (!critic)
+            {
+                rwq_time = hz_200;      /* try again later */
+                return ret;
+            }
+            if (!err)
+            {
+                err = ret;
+                rwq_errdev = e->dev;
+            }
+            continue;
+        }
+        units[e->unit].last_access = hz_200;
+    }
+
+    rwq_count = 0;
+    rqstat.rq_queued = 0;
+
+    return err;
+}
+
+/*
+ * return TRUE iff anything is queued for 'unit' (-1 => any unit)
+ */
+static BOOL rwq_holds(WORD unit)
+{
+    WORD i;
+
+    if (unit < 0)
+        return rwq_count > 0;
+
+    i = rwq_find(unit, 0UL);
+
+    return (i < rwq_count) && (rwq[i].unit == unit);
+}
+
+/*
+ * write out the queue if it holds anything for 'unit' (-1 => any unit)
+ */
+LONG rwq_flush(WORD unit)
+{
+    if (!rwq_holds(unit))
+        return 0L;
+
+    return rwq_writeout(TRUE);
+}
+
+/*
+ * likewise, but without reporting errors: this is used for Rwabs()
+ * requests with RW_NOCRITIC
+ */
+LONG rwq_quietflush(WORD unit)
+{
+    if (!rwq_holds(unit))
+        return 0L;
+
+    return rwq_writeout(FALSE);
+}
+
+/*
+ * write out the queue if it holds any of the specified sectors; this
+ * must be called before they are transferred by other means.  errors
+ * are only reported if 'critic' is TRUE.
+ */
+LONG rwq_sync(WORD unit, ULONG sector, LONG count, BOOL critic)
+{
+    if (!rwq_overlaps(unit, sector, count))
+        return 0L;
+
+    rqstat.rq_overlaps++;
+
+    return rwq_writeout(critic);
+}
+
+/*
+ * queue a logical write
+ *
+ * returns 0 if the sectors have been queued, 1 if the caller must write
+ * them itself, or a negative error code if the queue had to be written
+ * out and this failed
+ */
+LONG rwq_write(WORD unit, WORD dev, ULONG sector, LONG count, UBYTE *buf)
+{
+    RWQENTRY *e;
+    LONG ret;
+    WORD i;
+
+    if (!rwq_buf || (count > RWQ_MAXWRITE) || (units[unit].psshift != RWQ_SHIFT))
+    {
+        ret = rwq_sync(unit, sector, count, TRUE);
+        return ret ? ret : 1L;
+    }
+
+    /*
+     * if the queue is full and can't be written out, the caller writes
+     * the sectors itself, so any queued copies of them are now obsolete
+     */
+    if (rwq_count + count > RWQ_SECTORS)
+    {
+        if (rwq_writeout(FALSE) < 0L)
+        {
+            rqstat.rq_rewrites += rwq_remove(unit, sector, sector + count);
+            rqstat.rq_queued = rwq_count;
+            return 1L;
+        }
+    }
+
+    if (rwq_count == 0)
+        rwq_time = hz_200;
+
+    for ( ; count > 0; count--, sector++, buf += SECTOR_SIZE)
+    {
+        i = rwq_find(unit, sector);
+        e = &rwq[i];
+        if ((i < rwq_count) && (e->unit == unit) && (e->sector == sector))
+            rqstat.rq_rewrites++;
+        else
+        {
+            memmove(e+1, e, (rwq_count-i)*sizeof(RWQENTRY));
+            e->unit = unit;
+            e->dev = dev;
+            e->sector = sector;
+            e->data = rwq_buf + rwq_count*SECTOR_SIZE;
+            rwq_count++;
+        }
+        memcpy(e->data, buf, SECTOR_SIZE);
+        rqstat.rq_sectors++;
+    }
+
+    rqstat.rq_requests++;
+    rqstat.rq_queued = rwq_count;
+
+    return 0L;
+}
+
+/*
+ * throw away anything queued for 'unit', because its media has changed
+ */
+void rwq_discard(WORD unit)
+{
+    rqstat.rq_discards += rwq_remove(unit, 0UL, 0xffffffffUL);
+    rqstat.rq_queued = rwq_count;
+}
+
+/*
+ * write out the queue in the background
+ *
+ * this is called from the VBL interrupt by blkdev_vblflush(), when
+ * neither the BDOS nor the BIOS is active
+ */
+void rwq_vblflush(void)
+{
+    if (rwq_count == 0)
+        return;
+    if (hz_200 - rwq_time < RWQ_AGE)
+        return;
+
+    rwq_writeout(FALSE);
+}
+
+#endif /* CONF_WITH_RWQUEUE */
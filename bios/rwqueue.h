@@ -0,0 +1,25 @@
+/*
+ * rwqueue.h - header for the hard disk write queue
+ *
+ * Copyright (C) 2026 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+#ifndef _RWQUEUE_H
+#define _RWQUEUE_H
+
+#if CONF_WITH_RWQUEUE
+
+void rwq_init(void);
+LONG rwq_write(WORD unit, WORD dev, ULONG sector, LONG count, UBYTE *buf);
+LONG rwq_sync(WORD unit, ULONG sector, LONG count, BOOL critic);
+LONG rwq_quietflush(WORD unit);
+void rwq_discard(WORD unit);
+void rwq_vblflush(void);
+
+/* rwq_flush() is declared in biosext.h */
+
+#endif /* CONF_WITH_RWQUEUE */
+
+#endif /* _RWQUEUE_H */
@@ -135,6 +135,9 @@ static int sd_wait_for_not_busy(LONG timeout);
 static int sd_wait_for_not_idle(UBYTE cmd,ULONG arg);
 static int sd_wait_for_ready(LONG timeout);
 static LONG sd_write(UWORD drv,ULONG sector,UWORD count,UBYTE *buf);
+#if CONF_WITH_SDMMC_CRC
+static UWORD sd_crc16(const UBYTE *p,UWORD len);
+#endif
 
 
 /*
@@ -553,11 +556,15 @@ static int sd_command(UBYTE cmd,ULONG argument,UBYTE crc,UBYTE resp_type,UBYTE *
  *
  *  returns -1 timeout or unexpected start token
  *          0   ok
+ *          1   crc error (only if CONF_WITH_SDMMC_CRC)
  */
 static int sd_receive_data(UBYTE *buf,UWORD len,UWORD special)
 {
 LONG i;
 UBYTE token;
+#if CONF_WITH_SDMMC_CRC
+UWORD crc;
+#endif
 
     /* wait for the token */
     if (special) {
@@ -587,15 +594,24 @@ UBYTE token;
      *  transfer data
      */
     if (buf) {
-        for (i = 0; i < len; i++)
-            *buf++ = spi_recv_byte();
+        spi_recv_block(buf,len);
     } else {
         for (i = 0; i < len; i++)
             spi_recv_byte();
     }
 
+#if CONF_WITH_SDMMC_CRC
+    /* the card always sends a valid crc for data blocks */
+    crc = spi_recv_byte() << 8;
+    crc |= spi_recv_byte();
+    if (buf && (crc != sd_crc16(buf,len))) {
+        KDEBUG(("sd_receive_data() crc error\n"));
+        return 1;
+    }
+#else
     spi_recv_byte();        /* discard crc */
     spi_recv_byte();
+#endif
 
     return 0;
 }
@@ -608,7 +624,6 @@ UBYTE token;
  */
 static int sd_send_data(UBYTE *buf,UWORD len,UBYTE token)
 {
-LONG i;
 UBYTE rtoken;
 
     spi_send_byte(token);
@@ -616,8 +631,7 @@ UBYTE rtoken;
         spi_recv_byte();    /* skip a byte before testing for busy */
     } else {
         /* send the data */
-        for (i = 0; i < len; i++)
-            spi_send_byte(*buf++);
+        spi_send_block(buf,len);
         spi_send_byte(0xff);        /* send dummy crc */
         spi_send_byte(0xff);
 
@@ -878,4 +892,27 @@ UBYTE c;
     return -1;
 }
 
+#if CONF_WITH_SDMMC_CRC
+/*
+ *  calculate the CRC16 used for data blocks (polynomial x^16+x^12+x^5+1,
+ *  initial value 0), a nibble at a time
+ */
+static const UWORD crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef
+};
+
+static UWORD sd_crc16(const UBYTE *p,UWORD len)
+{
+UWORD crc = 0;
+
+    while(len--) {
+        crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (*p >> 4)];
+        crc = (crc << 4) ^ crc16_nibble[(crc >> 12) ^ (*p++ & 0x0f)];
+    }
+
+    return crc;
+}
+#endif
+
 #endif /* CONF_WITH_SDMMC */
@@ -21,4 +21,11 @@ void spi_initialise(void);
 UBYTE spi_recv_byte(void);
 void spi_send_byte(UBYTE input);
 
+/*
+ * block transfers: these are equivalent to calling spi_recv_byte() or
+ * spi_send_byte() 'len' times, but avoid the call overhead per byte
+ */
+void spi_recv_block(UBYTE *buf, UWORD len);
+void spi_send_block(const UBYTE *buf, UWORD len);
+
 #endif /* _SPI_H */
@@ -77,4 +77,37 @@ UBYTE spi_recv_byte(void)
     /* reading will stall until transmission is complete */
     return SAGA_SDCARD_DATA;
 }
+
+/*
+ * the block transfers are unrolled 8 times, and keep the address of
+ * the data register in an address register
+ */
+#define RECV_BYTE   { *data = 0xFF; *buf++ = *data; }
+#define SEND_BYTE   { *data = *buf++; FORCE_READ(*data); }
+
+void spi_recv_block(UBYTE *buf, UWORD len)
+{
+    volatile UBYTE *data = &SAGA_SDCARD_DATA;
+    UWORD n;
+
+    for (n = len >> 3; n; n--) {
+        RECV_BYTE RECV_BYTE RECV_BYTE RECV_BYTE
+        RECV_BYTE RECV_BYTE RECV_BYTE RECV_BYTE
+    }
+    for (n = len & 7; n; n--)
+        RECV_BYTE
+}
+
+void spi_send_block(const UBYTE *buf, UWORD len)
+{
+    volatile UBYTE *data = &SAGA_SDCARD_DATA;
+    UWORD n;
+
+    for (n = len >> 3; n; n--) {
+        SEND_BYTE SEND_BYTE SEND_BYTE SEND_BYTE
+        SEND_BYTE SEND_BYTE SEND_BYTE SEND_BYTE
+    }
+    for (n = len & 7; n; n--)
+        SEND_BYTE
+}
 #endif /* CONF_WITH_VAMPIRE_SPI */
@@ -34,6 +34,7 @@
 #include "disk.h"
 #include "clock.h"
 #include "nvram.h"
+#include "biosext.h"
 #include "mouse.h"
 #include "asm.h"
 #include "vectors.h"
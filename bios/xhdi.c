@@ -19,6 +19,7 @@
 #include "string.h"
 #include "disk.h"
 #include "ahdi.h"
+#include "rwqueue.h"
 
 
 #if CONF_WITH_XHDI
@@ -119,7 +120,11 @@ static long XHInqDev2(UWORD drv, UWORD *major, UWORD *minor, ULONG *start,
         *start = pstart;
 
     myBPB = (BPB *)blkdev_getbpb(drv);
-    if (bpb && myBPB)
+    /*
+     * a FAT32 BPB cannot be described by the standard BPB, so we
+     * report it as a non-GEMDOS partition, like Atari TOS would
+     */
+    if (bpb && myBPB && !(myBPB->b_flags & B_32))
         memcpy(bpb, myBPB, sizeof(BPB));
 
     if (blocks)
@@ -317,7 +322,11 @@ static long XHDOSLimits(UWORD which, ULONG limit)
 
         case XH_DL_CLUSTS32:
             /* Max. number of clusters of a 32 bit FAT */
+#if CONF_WITH_FAT32
+            ret = MAX_FAT32_CLUSTERS;
+#else
             ret = EINVFN; /* No FAT32 support. */
+#endif
             break;
 
         case XH_DL_BFLAGS:
@@ -429,6 +438,9 @@ static long XHReadWrite(UWORD major, UWORD minor, UWORD rw, ULONG sector,
                  UWORD count, UBYTE *buf)
 {
     UWORD unit;
+#if CONF_WITH_RWQUEUE
+    LONG ret;
+#endif
 
     KDEBUG(("XHReadWrite(device=%u.%u, rw=%u, sector=%lu, count=%u, buf=%p)\n",
             major, minor, rw, sector, count, buf));
@@ -446,6 +458,12 @@ static long XHReadWrite(UWORD major, UWORD minor, UWORD rw, ULONG sector,
 
     unit = NUMFLOPPIES + major;
 
+#if CONF_WITH_RWQUEUE
+    ret = rwq_sync(unit, sector, count, TRUE);
+    if (ret < 0)
+        return ret;
+#endif
+
     return disk_rw(unit, rw, sector, count, buf);
 }
 
@@ -42,10 +42,13 @@ extern LONG jmp_xbios(WORD, ...);
 #define jmp_gemdos_l(a,b)       jmp_gemdos((WORD)(a),(LONG)(b))
 #define jmp_gemdos_p(a,b)       jmp_gemdos((WORD)(a),(void*)(b))
 #define jmp_gemdos_ww(a,b,c)    jmp_gemdos((WORD)(a),(WORD)(b),(WORD)(c))
+#define jmp_gemdos_lww(a,b,c,d) jmp_gemdos((WORD)(a),(LONG)(b),(WORD)(c),(WORD)(d))
+#define jmp_gemdos_wwl(a,b,c,d) jmp_gemdos((WORD)(a),(WORD)(b),(WORD)(c),(LONG)(d))
 #define jmp_gemdos_pw(a,b,c)    jmp_gemdos((WORD)(a),(void *)(b),(WORD)(c))
 #define jmp_gemdos_wlp(a,b,c,d) jmp_gemdos((WORD)(a),(WORD)(b),(LONG)(c),(void *)(d))
 #define jmp_gemdos_wpp(a,b,c,d) jmp_gemdos((WORD)(a),(WORD)(b),(void *)(c),(void *)(d))
 #define jmp_gemdos_pww(a,b,c,d) jmp_gemdos((WORD)(a),(void *)(b),(WORD)(c),(WORD)(d))
+#define jmp_gemdos_pwpl(a,b,c,d,e)  jmp_gemdos((WORD)(a),(void *)(b),(WORD)(c),(void *)(d),(LONG)(e))
 #define jmp_gemdos_wppp(a,b,c,d,e)  jmp_gemdos((WORD)(a),(WORD)(b),(void *)(c),(void *)(d),(void *)(e))
 #define jmp_bios_w(a,b)         jmp_bios((WORD)(a),(WORD)(b))
 #define jmp_bios_ww(a,b,c)      jmp_bios((WORD)(a),(WORD)(b),(WORD)(c))
@@ -68,6 +71,7 @@ extern LONG jmp_xbios(WORD, ...);
 #define Fread(a,b,c)        jmp_gemdos_wlp(0x3f,a,b,c)
 #define Fwrite(a,b,c)       jmp_gemdos_wlp(0x40,a,b,c)
 #define Fdelete(a)          jmp_gemdos_p(0x41,a)
+#define Fseek(a,b,c)        jmp_gemdos_lww(0x42,a,b,c)
 #define Fattrib(a,b,c)      jmp_gemdos_pww(0x43,a,b,c)
 #define Fdup(a)             jmp_gemdos_w(0x45,a)
 #define Fforce(a,b)         jmp_gemdos_ww(0x46,a,b)
@@ -78,6 +82,8 @@ extern LONG jmp_xbios(WORD, ...);
 #define Fsfirst(a,b)        jmp_gemdos_pw(0x4e,a,b)
 #define Fsnext()            jmp_gemdos_v(0x4f)
 #define Frename(a,b,c)      jmp_gemdos_wpp(0x56,a,b,c)
+#define Fslist(a,b,c,d)     jmp_gemdos_pwpl(0x59,a,b,c,d)
+#define Fcopy(a,b,c)        jmp_gemdos_wwl(0x5a,a,b,c)
 
 #define Bconstat(a)         jmp_bios_w(0x01,a)
 #define Bconin(a)           jmp_bios_w(0x02,a)
@@ -98,6 +104,7 @@ extern LONG jmp_xbios(WORD, ...);
 #define MAXCMDLINE      125     /* the most amount of real data allowed */
 
 #define IOBUFSIZE       16384L  /* buffer size */
+#define LSBUFSIZE       (sizeof(FSLIST)+32*sizeof(FSENTRY)) /* Fslist() buffer size */
 
 #define MAX_LINE_SIZE   200L    /* must be greater than the largest screen width */
 #define HISTORY_SIZE    10      /* number of lines of history */
@@ -143,6 +150,21 @@ typedef struct {
     char    d_fname[14];
 } DTA;
 
+typedef struct {            /* Fslist() buffer header */
+    LONG    fl_cookie;
+    WORD    fl_count;
+    WORD    fl_reserved;
+} FSLIST;
+
+typedef struct {            /* Fslist() entry: same layout as DTA from d_attrib */
+    char    fe_reserved;
+    char    fe_attr;
+    WORD    fe_time;
+    WORD    fe_date;
+    LONG    fe_length;
+    char    fe_name[14];
+} FSENTRY;
+
 /* Type of function run by execute() */
 typedef LONG FUNC(WORD argc,char **argv);
 
@@ -156,6 +178,7 @@ typedef LONG FUNC(WORD argc,char **argv);
 /*
  *  manifest constants
  */
+#define EINVFN          -32
 #define EFILNF          -33
 #define EPTHNF          -34
 #define ENHNDL          -35
@@ -35,6 +35,8 @@ PRIVATE WORD help_lines(const COMMAND *p);
 PRIVATE WORD help_pause(void);
 PRIVATE WORD help_wanted(const COMMAND *p,char *cmd);
 PRIVATE LONG is_valid_drive(char drive_letter);
+PRIVATE LONG ls_bulk(char *filespec,WORD detail,WORD names_per_line,WORD *n);
+PRIVATE void ls_entry(WORD detail,WORD names_per_line,WORD *n);
 PRIVATE void output(const char *s);
 PRIVATE void outputnl(const char *s);
 PRIVATE LONG outputbuf(const char *s,LONG len,WORD paging);
@@ -358,10 +360,70 @@ const char * const *s;
     return 0L;
 }
 
+/*
+ *  display the directory entry in the DTA, for run_ls()
+ */
+PRIVATE void ls_entry(WORD detail,WORD names_per_line,WORD *n)
+{
+char buf[20];
+
+    if (detail) {
+        display_dta_detail();
+    } else if (dta->d_fname[0] != '.') {
+        padname(buf,dta->d_fname);
+        output(buf);
+        if (++*n >= names_per_line) {
+            outputnl("");
+            *n = 0;
+        }
+    }
+}
+
+/*
+ *  list directory entries for run_ls() via Fslist()
+ *
+ *  each entry is copied to the DTA, so that it can be displayed in
+ *  the same way as one returned by Fsfirst()/Fsnext().  returns EINVFN
+ *  if Fslist() is not available (or there is no memory for its buffer).
+ */
+PRIVATE LONG ls_bulk(char *filespec,WORD detail,WORD names_per_line,WORD *n)
+{
+FSLIST *list;
+FSENTRY *fe;
+LONG rc, found = 0L;
+
+    list = (FSLIST *)Malloc(LSBUFSIZE);
+    if (!list)
+        return EINVFN;
+
+    list->fl_cookie = 0L;
+    do {
+        rc = Fslist(filespec,0x17,list,LSBUFSIZE);
+        if (rc < 0L)
+            break;
+        for (fe = (FSENTRY *)(list+1); rc; rc--, fe++, found++) {
+            if (constat()) {
+                if (user_input(-1)) {
+                    Mfree(list);
+                    return USER_BREAK;
+                }
+            }
+            memcpy(&dta->d_attrib,&fe->fe_attr,23);
+            ls_entry(detail,names_per_line,n);
+        }
+    } while(list->fl_cookie);
+
+    Mfree(list);
+
+    if ((rc == 0L) && !found)   /* match Fsfirst() */
+        rc = EFILNF;
+
+    return rc;
+}
+
 PRIVATE LONG run_ls(WORD argc,char **argv)
 {
 char filespec[MAXPATHLEN];
-char buf[20];
 LONG rc;
 WORD names_per_line, n;
 WORD detail = 0;
@@ -385,19 +447,14 @@ WORD detail = 0;
         output(_("Listing of "));
         outputnl(filespec);
     }
-    for (rc = Fsfirst(filespec,0x17), n = 0; rc == 0; rc = Fsnext()) {
-        if (constat())
-            if (user_input(-1))
-                return USER_BREAK;
-        if (detail) {
-            display_dta_detail();
-        } else if (dta->d_fname[0] != '.') {
-            padname(buf,dta->d_fname);
-            output(buf);
-            if (++n >= names_per_line) {
-                outputnl("");
-                n = 0;
-            }
+    n = 0;
+    rc = ls_bulk(filespec,detail,names_per_line,&n);
+    if (rc == EINVFN) {         /* not available, use Fsfirst()/Fsnext() */
+        for (rc = Fsfirst(filespec,0x17); rc == 0; rc = Fsnext()) {
+            if (constat())
+                if (user_input(-1))
+                    return USER_BREAK;
+            ls_entry(detail,names_per_line,&n);
         }
     }
     if (n)
@@ -787,9 +844,9 @@ PRIVATE LONG copy_move(WORD argc,char **argv,WORD delete)
 {
 char inname[MAXPATHLEN], outname[MAXPATHLEN], fullname[MAXPATHLEN];
 char *inptr, *outptr;
-WORD in, out, output_is_dir = 0;
+WORD in, out, output_is_dir = 0, use_fcopy = 1;
 char *iobuf;
-LONG bufsize, n, rc;
+LONG bufsize, n, left, rc;
 
     inptr = extract_path(inname,argv[1]);
     outptr = extract_path(outname,argv[2]);
@@ -872,6 +929,9 @@ LONG bufsize, n, rc;
         }
         out = LOWORD(rc);
 
+        left = Fseek(0L,in,2);  /* file length, for Fcopy() */
+        Fseek(0L,in,0);
+
         do {
             /* allow user to interrupt during file copy/move */
             if (constat()) {
@@ -880,6 +940,25 @@ LONG bufsize, n, rc;
                     break;
                 }
             }
+            /*
+             * use Fcopy() if available: if it isn't, or if it has
+             * no memory, fall back to Fread()/Fwrite() for good
+             */
+            if (use_fcopy) {
+                n = (left < bufsize) ? left : bufsize;
+                rc = Fcopy(in,out,n);
+                if ((rc == EINVFN) || (rc == ENSMEM)) {
+                    use_fcopy = 0;
+                    rc = 1L;
+                    continue;
+                }
+                if (rc < 0L)
+                    break;
+                if (rc != n)
+                    rc = DISK_FULL;
+                left -= n;
+                continue;
+            }
             n = rc = Fread(in,bufsize,iobuf);
             if (rc < 0L)
                 break;
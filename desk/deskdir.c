@@ -391,9 +391,12 @@ static WORD output_fname(char *psrc_file, char *pdst_file)
  */
 static WORD d_dofcopy(char *psrc_file, char *pdst_file, WORD time, WORD date, WORD attr)
 {
-    BOOL diskfull = FALSE;
+    BOOL diskfull = FALSE, aborted = FALSE;
     WORD srcfh, dstfh, rc;
     LONG readlen, writelen, error;
+#if CONF_WITH_FCOPY
+    LONG length, n;
+#endif
 
     while(1)
     {
@@ -447,6 +450,45 @@ static WORD d_dofcopy(char *psrc_file, char *pdst_file, WORD time, WORD date, WO
      * perform copy
      */
     rc = TRUE;
+#if CONF_WITH_FCOPY
+    /*
+     * let the BDOS copy the data directly, one buffer's worth at a time
+     * so that the user can still abort.  if Fcopy() is not available
+     * (EINVFN), or if the BDOS has no memory for its buffer (ENSMEM),
+     * we carry on ourselves as usual.
+     */
+    readlen = 0L;
+    length = dos_lseek(srcfh, 2, 0L);   /* get the current file length */
+    dos_lseek(srcfh, 0, 0L);
+    do
+    {
+        n = (length < copylen) ? length : copylen;
+        error = writelen = dos_copy(srcfh, dstfh, n);
+        if (error < 0L)
+            break;
+        if (writelen != n)
+        {
+            fun_alert_merge(1, STDISKFU, pdst_file[0]);
+            diskfull = TRUE;
+            break;
+        }
+        length -= n;
+        if (length && user_abort())
+        {
+            aborted = TRUE;
+            break;
+        }
+    } while(length > 0L);
+
+    if ((error >= 0L) && !diskfull && !aborted)
+        dos_setdt(dstfh, time, date);   /* update target date/time */
+    else if ((error == EINVFN) || (error == ENSMEM))
+        error = 0L;
+    else if ((error < 0L) && (error != EWRITF) && (error != EWRPRO))
+        readlen = error;    /* report it as a read error */
+
+    if ((error == 0L) && (length > 0L) && !diskfull && !aborted)
+#endif
     while(1)
     {
         error = readlen = dos_read(srcfh, copylen, copybuf);
@@ -491,7 +533,7 @@ static WORD d_dofcopy(char *psrc_file, char *pdst_file, WORD time, WORD date, WO
     dos_close(srcfh);       /* close files */
     dos_close(dstfh);
 
-    if (diskfull)
+    if (diskfull || aborted)    /* don't leave an incomplete file */
     {
         dos_delete(pdst_file);
         rc = FALSE;
@@ -907,6 +949,10 @@ WORD dir_op(WORD op, WORD icontype, PNODE *pspath, char *pdst_path, DIRCOUNT *co
     case OP_COPY:
     case OP_MOVE:
         lavail = dos_avail_stram() - 0x400; /* allow safety margin */
+#if CONF_WITH_FCOPY
+        if (lavail >= 2*FCOPY_BUFSIZE)      /* leave room for Fcopy() */
+            lavail -= FCOPY_BUFSIZE;
+#endif
         if (lavail < 0L)
         {
             desk_busy_off();
@@ -36,6 +36,11 @@
 
 #include "string.h"
 
+#if CONF_WITH_FSLIST
+#define NM_FSLIST   16          /* entries returned per dos_slist() call */
+#define LEN_FSLIST  (sizeof(FSLIST)+NM_FSLIST*sizeof(FSENTRY))
+#endif
+
 
 /*
  *  Free the file nodes for a specified pathnode
@@ -221,13 +226,24 @@ FNODE *pn_sort(PNODE *pn)
  *              filenode list.  our excuse is that Atari TOS does this too ...
  *          <0  error (other than EFILNF/ENMFIL) returned by dos_sfirst()/dos_snext()
  *              (e.g. when attempting to open a floppy drive with no disk)
+ *
+ *  if CONF_WITH_FSLIST, the directory is read via dos_slist(); if that
+ *  is not available (EINVFN), or if there is no memory for its buffer,
+ *  we use dos_sfirst()/dos_snext() instead
  */
 WORD pn_active(PNODE *pn, BOOL include_folders)
 {
+#if CONF_WITH_FSLIST
+    FSLIST *list = NULL;
+    FSENTRY *fe;
+    LONG n;
+#endif
     DTA *dtasave;
+    BOOL fallback = TRUE;
     FNODE *fn, *prev;
     LONG maxmem, maxcount, size = 0L;
     WORD count, ret;
+    char *spec;
 #if CONF_WITH_FILEMASK
     char search[MAXPATHLEN];
     char *match;
@@ -236,16 +252,30 @@ WORD pn_active(PNODE *pn, BOOL include_folders)
     fl_free(pn);                    /* free any existing filenodes */
 
     maxmem = dos_avail_anyram();    /* allocate max possible memory */
+#if CONF_WITH_FSLIST
+    /*
+     * the Fslist() buffer goes at the end of the allocated memory, so
+     * that it is released by the dos_shrink() below
+     */
+    maxmem -= LEN_FSLIST;
+    if (maxmem < 0L)
+        maxmem = 0L;
+#endif
     maxcount = maxmem / sizeof(FNODE);
     if (maxcount)
+    {
+#if CONF_WITH_FSLIST
+        pn->p_fbase = dos_alloc_anyram(maxcount*sizeof(FNODE)+LEN_FSLIST);
+        if (pn->p_fbase)
+            list = (FSLIST *)(pn->p_fbase + maxcount);
+#else
         pn->p_fbase = dos_alloc_anyram(maxmem);
+#endif
+    }
 
     fn = pn->p_fbase;
     prev = (FNODE *)&pn->p_flist;   /* assumes fnode link is at start of fnode */
 
-    dtasave = dos_gdta();           /* so we can preserve it */
-    dos_sdta(&G.g_wdta);
-
 #if CONF_WITH_FILEMASK
     strcpy(search, pn->p_spec);
     /*
@@ -254,23 +284,76 @@ WORD pn_active(PNODE *pn, BOOL include_folders)
     if (include_folders)                /* match all folders? */
         del_fname(search);              /* yes - change search filespec to *.* */
     match = filename_start(pn->p_spec); /* the match filespec is always unaltered */
-    for (ret = dos_sfirst(search, pn->p_attr), count = 0; (ret == 0) && (count < maxcount); ret = dos_snext())
+    spec = search;
+#else
+    spec = pn->p_spec;
+#endif
+
+#if CONF_WITH_FSLIST
+    ret = 0;
+    count = 0;
+    if (list)
+        list->fl_cookie = 0L;
+    while (list && (count < maxcount))
     {
-        if (G.g_wdta.d_attrib != FA_SUBDIR) /* skip *files* that don't match */
-            if (!wildcmp(match, G.g_wdta.d_fname))
+        n = dos_slist(spec, pn->p_attr, list, LEN_FSLIST);
+        if (n < 0L)
+        {
+            ret = (WORD)n;
+            break;
+        }
+        for (fe = (FSENTRY *)(list+1); n && (count < maxcount); n--, fe++)
+        {
+#if CONF_WITH_FILEMASK
+            if (fe->fe_attr != FA_SUBDIR)   /* skip *files* that don't match */
+                if (!wildcmp(match, fe->fe_name))
+                    continue;
+#endif
+            if (fe->fe_name[0] == '.')  /* skip "." & ".." entries */
                 continue;
-#else
-    for (ret = dos_sfirst(pn->p_spec,pn->p_attr), count = 0; (ret == 0) && (count < maxcount); ret = dos_snext())
+            fn->f_selected = FALSE;
+            memcpy(&fn->f_attr, &fe->fe_attr, 23);
+            fn->f_seq = count++;
+            size += fn->f_size;
+            prev->f_next = fn;      /* link fnodes */
+            prev = fn++;
+        }
+        if (list->fl_cookie == 0L)  /* end of directory */
+            break;
+    }
+
+    fallback = !list || (ret == EINVFN);
+    if (fallback)                   /* discard anything we have so far */
+    {
+        fn = pn->p_fbase;
+        prev = (FNODE *)&pn->p_flist;
+        size = 0L;
+    }
+#endif
+
+    if (fallback)
     {
+        dtasave = dos_gdta();       /* so we can preserve it */
+        dos_sdta(&G.g_wdta);
+
+        for (ret = dos_sfirst(spec, pn->p_attr), count = 0; (ret == 0) && (count < maxcount); ret = dos_snext())
+        {
+#if CONF_WITH_FILEMASK
+            if (G.g_wdta.d_attrib != FA_SUBDIR) /* skip *files* that don't match */
+                if (!wildcmp(match, G.g_wdta.d_fname))
+                    continue;
 #endif
-        if (G.g_wdta.d_fname[0] == '.') /* skip "." & ".." entries */
-            continue;
-        fn->f_selected = FALSE;
-        memcpy(&fn->f_attr, &G.g_wdta.d_attrib, 23);
-        fn->f_seq = count++;
-        size += fn->f_size;
-        prev->f_next = fn;      /* link fnodes */
-        prev = fn++;
+            if (G.g_wdta.d_fname[0] == '.') /* skip "." & ".." entries */
+                continue;
+            fn->f_selected = FALSE;
+            memcpy(&fn->f_attr, &G.g_wdta.d_attrib, 23);
+            fn->f_seq = count++;
+            size += fn->f_size;
+            prev->f_next = fn;      /* link fnodes */
+            prev = fn++;
+        }
+
+        dos_sdta(dtasave);          /* restore original DTA for neatness */
     }
     prev->f_next = NULL;        /* terminate chain */
     pn->p_count = count;        /* & update pathnode */
@@ -290,8 +373,6 @@ WORD pn_active(PNODE *pn, BOOL include_folders)
     if (count >= maxcount)
         KDEBUG(("Not enough FNODEs for folder %s\n",pn->p_spec));
 
-    dos_sdta(dtasave);          /* restore original DTA for neatness */
-
     return ((ret==ENMFIL) || (ret==EFILNF)) ? 0 : ret;
 }
 
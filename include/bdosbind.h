@@ -52,5 +52,9 @@ extern long trap1_pexec(short mode, const char *path, const char *tail, const ch
 #define Fsnext() trap1(0x4f)
 #define Frename(oldname,newname) trap1(0x56, 0, oldname, newname)
 #define Fdatime(timeptr,handle,wflag) trap1(0x57, timeptr, handle, wflag)
+#define Sstat(which,buf,len) trap1(0x58, which, buf, len)
+#define Fslist(fname,attr,buf,len) trap1(0x59, fname, attr, buf, len)
+#define Fcopy(srchandle,dsthandle,count) trap1(0x5a, srchandle, dsthandle, count)
+#define Mpolicy(policy) trap1(0x5b, policy)
 
 #endif /* _BDOSBIND_H */
@@ -123,4 +123,165 @@ struct _mpb
 
 #define PATH_ENV "PATH="    /* PATH environment variable */
 
+/*
+ * Values of 'which' for Sstat() (EmuTOS extension)
+ */
+#define SS_BUFCACHE     0       /* BDOS sector buffer cache (BCSTAT) */
+#define SS_PEXECCACHE   1       /* Pexec() program image cache (PXSTAT) */
+#define SS_PGMLOAD      2       /* program loading from disk (PLSTAT) */
+#define SS_MEMORY       3       /* free memory & Malloc() (MEMSTAT) */
+#define SS_OSMEM        4       /* internal BDOS memory pool (OSMSTAT) */
+#define SS_RWQUEUE      5       /* BIOS write queue for hard disks (RQSTAT) */
+#define SS_FLUSH        0x4000  /* flag: empty the cache first (SS_PEXECCACHE), */
+                                /*  or write out the queue (SS_RWQUEUE)        */
+#define SS_RESET        0x8000  /* flag: clear counters after copying */
+
+/*
+ *  BCSTAT - sector buffer cache statistics, returned by Sstat()
+ */
+typedef struct
+{
+        UWORD   bc_nfat;        /* number of buffers in FAT list */
+        UWORD   bc_ndata;       /* number of buffers in dir/data list */
+        ULONG   bc_hits;        /* records found in a buffer */
+        ULONG   bc_misses;      /* records that had to be read */
+        ULONG   bc_evictions;   /* valid buffers reused for another record */
+        ULONG   bc_writes;      /* number of Rwabs() writes */
+        ULONG   bc_wrecs;       /* number of records written */
+        ULONG   bc_rarecs;      /* records read ahead */
+        ULONG   bc_rahits;      /* ... which were subsequently used */
+        ULONG   bc_rawaste;     /* ... which were discarded unused */
+        ULONG   bc_lazywrites;  /* number of Rwabs() writes in the background */
+        ULONG   bc_lazyrecs;    /* number of records written in the background */
+        ULONG   bc_lazysaved;   /* evictions that found the buffer already */
+                                /*  written back in the background         */
+} BCSTAT;
+
+/*
+ *  PXSTAT - program image cache statistics, returned by Sstat()
+ */
+typedef struct
+{
+        UWORD   px_entries;     /* number of programs in the cache */
+        ULONG   px_bytes;       /* memory used by the cache */
+        ULONG   px_limit;       /* maximum memory used by the cache */
+        ULONG   px_hits;        /* programs loaded from the cache */
+        ULONG   px_misses;      /* programs loaded from disk */
+        ULONG   px_fills;       /* ... which were added to the cache */
+        ULONG   px_evictions;   /* programs discarded to make room */
+} PXSTAT;
+
+/*
+ *  PLSTAT - program loading statistics, returned by Sstat()
+ */
+typedef struct
+{
+        ULONG   pl_loads;       /* programs loaded from disk */
+        ULONG   pl_onepass;     /* ... with a single read of the whole file */
+        ULONG   pl_bytes;       /* bytes read from program files */
+        ULONG   pl_rwabs;       /* Rwabs() calls while loading programs */
+        ULONG   pl_relocs;      /* longwords relocated */
+        ULONG   pl_reloctime;   /* time spent relocating, in 200 Hz ticks */
+} PLSTAT;
+
+/*
+ * Values of 'policy' for Mpolicy() (EmuTOS extension)
+ */
+#define MP_FIRSTFIT     0       /* use the first free block that fits, like TOS */
+#define MP_BESTFIT      1       /* use the smallest free block that fits */
+
+/*
+ *  MEMSTAT - memory statistics, returned by Sstat()
+ */
+typedef struct
+{
+        ULONG   mp_free;        /* total free memory */
+        ULONG   mp_largest;     /* largest free block */
+        UWORD   mp_nfree;       /* number of free blocks */
+        UWORD   mp_frag;        /* free memory outside the largest block, */
+                                /*  in thousandths of the total           */
+} MPSTAT;
+
+typedef struct
+{
+        UWORD   ms_policy;      /* current Mpolicy() */
+        MPSTAT  ms_st;          /* ST-RAM */
+        MPSTAT  ms_alt;         /* Alt-RAM */
+        ULONG   ms_allocs;      /* blocks allocated */
+        ULONG   ms_fails;       /* failed allocations, although there was */
+                                /*  enough free memory in total           */
+        ULONG   ms_scanned;     /* free blocks examined */
+} MEMSTAT;
+
+/*
+ *  OSMSTAT - internal memory pool statistics, returned by Sstat()
+ *
+ *  the pool is made up of 64-byte blocks.  the os_inuse[] and os_peak[]
+ *  arrays are indexed by the type of block: MD blocks (3 MDs each), DMDs,
+ *  DNDs, OFDs, FAT maps and extent maps.
+ */
+#define OSM_NTYPES      6
+
+typedef struct
+{
+        UWORD   os_total;               /* blocks in the pool */
+        UWORD   os_free;                /* ... which are free */
+        UWORD   os_slabs;               /* slabs added to the pool */
+        UWORD   os_inuse[OSM_NTYPES];   /* blocks in use, by type */
+        UWORD   os_peak[OSM_NTYPES];    /* high-water marks, by type */
+        ULONG   os_scavenges;           /* times that DNDs had to be */
+                                        /*  freed to make room       */
+} OSMSTAT;
+
+/*
+ *  RQSTAT - BIOS write queue statistics, returned by Sstat()
+ *
+ *  the merge ratio is rq_requests / rq_transfers, i.e. the number of
+ *  queued Rwabs() writes per write command actually sent to a disk.
+ */
+typedef struct _rqstat RQSTAT;
+struct _rqstat
+{
+        UWORD   rq_size;        /* size of the queue in sectors (0 => none) */
+        UWORD   rq_queued;      /* sectors currently queued */
+        ULONG   rq_requests;    /* Rwabs() writes that were queued */
+        ULONG   rq_sectors;     /* sectors that were queued */
+        ULONG   rq_rewrites;    /* ... which replaced a queued sector */
+        ULONG   rq_transfers;   /* write commands sent when flushing */
+        ULONG   rq_flushes;     /* times the queue was written out */
+        ULONG   rq_overlaps;    /* ... because a transfer overlapped it */
+        ULONG   rq_errors;      /* write errors while flushing */
+        ULONG   rq_discards;    /* sectors thrown away after a media change */
+};
+
+/*
+ *  FSLIST - buffer header for Fslist() (EmuTOS extension)
+ *
+ *  the header is followed by as many FSENTRY structures as will fit
+ *  in the buffer.  from fe_attr onwards, an FSENTRY has the same layout
+ *  as the public part of a DTA.
+ */
+typedef struct
+{
+        LONG    fl_cookie;      /* in: 0 to start, else from previous call */
+                                /* out: to continue, or 0 at end of dir */
+        WORD    fl_count;       /* out: number of entries returned */
+        WORD    fl_reserved;
+} FSLIST;
+
+typedef struct
+{
+        char    fe_reserved;
+        char    fe_attr;        /* file attributes */
+        UWORD   fe_time;        /* time, like Tgettime() */
+        UWORD   fe_date;        /* date, like Tgetdate() */
+        LONG    fe_length;      /* file length */
+        char    fe_name[14];    /* file name, null-terminated */
+} FSENTRY;
+
+/*
+ *  largest internal buffer used by Fcopy() (EmuTOS extension)
+ */
+#define FCOPY_BUFSIZE   65536L
+
 #endif /* _BDOSDEFS_H */
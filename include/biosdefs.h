@@ -83,6 +83,26 @@ typedef struct _bpb BPB;
  */
 #define B_16    1       /* device has 16-bit FATs */
 #define B_1FAT  2       /* device has only a single FAT */
+#define B_32    4       /* device has 32-bit FATs (see BPB32) */
+
+/*
+ *  BPB32 - extended BPB for FAT32 (EmuTOS extension)
+ *
+ *  if B_32 is set in b_flags, the BPB returned by Getbpb() is the start
+ *  of this structure.  the 16-bit fsiz, fatrec, datrec and numcl fields
+ *  in the BPB are then zero (so that programs which do not know about
+ *  FAT32 will leave the device alone), and rdlen is zero too.
+ */
+typedef struct
+{
+    BPB   bpb;          /* standard BPB, as above */
+    ULONG fsiz;         /* FAT size in records */
+    ULONG fatrec;       /* first FAT record (of last FAT) */
+    ULONG datrec;       /* first data record */
+    ULONG numcl;        /* number of data clusters available */
+    ULONG rootcl;       /* first cluster of root directory */
+    UWORD fsinfo;       /* record number of FSInfo sector, or 0 */
+} BPB32;
 
 /*
  * Flags for Kbshift()
@@ -28,8 +28,17 @@
 #endif
 #define DSKBUF_SIZE     (DSKBUF_SECS * SECTOR_SIZE)
 
+/*
+ * EmuTOS extension: Rwabs() flag for the BDOS's own background I/O.
+ * Errors are returned without calling the critical error handler, and
+ * nothing that might call it is done on the way.  The other flags are
+ * in bios/disk.h.
+ */
+#define RW_NOCRITIC        64
+
 /* Forward declarations */
 struct _mcs;
+struct _rqstat;
 struct font_head;
 
 /* Bitmap of removable logical drives */
@@ -57,6 +66,11 @@ WORD cache_exists(void);
 void set_cache(WORD enable);
 #endif
 
+#if CONF_WITH_NVRAM
+/* XBios NVMaccess(), also used directly by the BDOS */
+WORD nvmaccess(WORD type, WORD start, WORD count, UBYTE *buffer);
+#endif
+
 /* bios allocation of ST-RAM */
 UBYTE *balloc_stram(ULONG size, BOOL top);
 
@@ -70,6 +84,14 @@ void halt(void) NORETURN;
 BOOL can_shutdown(void);
 #endif
 
+#if CONF_WITH_RWQUEUE
+/* hard disk write queue, also used directly by the BDOS for Sstat(),
+ * and when it flushes its buffers */
+extern struct _rqstat rqstat;
+extern WORD rwq_errdev;     /* logical drive of the first error reported */
+LONG rwq_flush(WORD unit);
+#endif
+
 #if CONF_WITH_EJECT
 void flop_eject(void);
 #endif
@@ -267,6 +267,54 @@
 # ifndef CONF_WITH_SHUTDOWN
 #  define CONF_WITH_SHUTDOWN 0
 # endif
+# ifndef CONF_WITH_BDOS_CACHE
+#  define CONF_WITH_BDOS_CACHE 0
+# endif
+# ifndef CONF_WITH_FAT_MAP
+#  define CONF_WITH_FAT_MAP 0
+# endif
+# ifndef CONF_WITH_EXTENT_MAP
+#  define CONF_WITH_EXTENT_MAP 0
+# endif
+# ifndef CONF_WITH_READAHEAD
+#  define CONF_WITH_READAHEAD 0
+# endif
+# ifndef CONF_WITH_LAZY_WRITEBACK
+#  define CONF_WITH_LAZY_WRITEBACK 0
+# endif
+# ifndef CONF_WITH_PREALLOC
+#  define CONF_WITH_PREALLOC 0
+# endif
+# ifndef CONF_WITH_FAT32
+#  define CONF_WITH_FAT32 0
+# endif
+# ifndef CONF_WITH_DIR_CACHE
+#  define CONF_WITH_DIR_CACHE 0
+# endif
+# ifndef CONF_WITH_FSLIST
+#  define CONF_WITH_FSLIST 0
+# endif
+# ifndef CONF_WITH_FCOPY
+#  define CONF_WITH_FCOPY 0
+# endif
+# ifndef CONF_WITH_PEXEC_CACHE
+#  define CONF_WITH_PEXEC_CACHE 0
+# endif
+# ifndef CONF_WITH_BESTFIT
+#  define CONF_WITH_BESTFIT 0
+# endif
+# ifndef CONF_WITH_OSMEM_SLABS
+#  define CONF_WITH_OSMEM_SLABS 0
+# endif
+# ifndef CONF_WITH_RAMDISK
+#  define CONF_WITH_RAMDISK 0
+# endif
+# ifndef CONF_WITH_FLOPPY_CACHE
+#  define CONF_WITH_FLOPPY_CACHE 0
+# endif
+# ifndef CONF_WITH_RWQUEUE
+#  define CONF_WITH_RWQUEUE 0
+# endif
 # ifndef MAX_VERTICES
 #  define MAX_VERTICES 512
 # endif
@@ -315,6 +363,54 @@
 # ifndef CONF_WITH_VDI_16BIT
 #  define CONF_WITH_VDI_16BIT 0
 # endif
+# ifndef CONF_WITH_BDOS_CACHE
+#  define CONF_WITH_BDOS_CACHE 0
+# endif
+# ifndef CONF_WITH_FAT_MAP
+#  define CONF_WITH_FAT_MAP 0
+# endif
+# ifndef CONF_WITH_EXTENT_MAP
+#  define CONF_WITH_EXTENT_MAP 0
+# endif
+# ifndef CONF_WITH_READAHEAD
+#  define CONF_WITH_READAHEAD 0
+# endif
+# ifndef CONF_WITH_LAZY_WRITEBACK
+#  define CONF_WITH_LAZY_WRITEBACK 0
+# endif
+# ifndef CONF_WITH_PREALLOC
+#  define CONF_WITH_PREALLOC 0
+# endif
+# ifndef CONF_WITH_FAT32
+#  define CONF_WITH_FAT32 0
+# endif
+# ifndef CONF_WITH_DIR_CACHE
+#  define CONF_WITH_DIR_CACHE 0
+# endif
+# ifndef CONF_WITH_FSLIST
+#  define CONF_WITH_FSLIST 0
+# endif
+# ifndef CONF_WITH_FCOPY
+#  define CONF_WITH_FCOPY 0
+# endif
+# ifndef CONF_WITH_PEXEC_CACHE
+#  define CONF_WITH_PEXEC_CACHE 0
+# endif
+# ifndef CONF_WITH_BESTFIT
+#  define CONF_WITH_BESTFIT 0
+# endif
+# ifndef CONF_WITH_OSMEM_SLABS
+#  define CONF_WITH_OSMEM_SLABS 0
+# endif
+# ifndef CONF_WITH_RAMDISK
+#  define CONF_WITH_RAMDISK 0
+# endif
+# ifndef CONF_WITH_FLOPPY_CACHE
+#  define CONF_WITH_FLOPPY_CACHE 0
+# endif
+# ifndef CONF_WITH_RWQUEUE
+#  define CONF_WITH_RWQUEUE 0
+# endif
 # ifndef MAX_VERTICES
 #  define MAX_VERTICES 512
 # endif
@@ -400,6 +496,54 @@
 # ifndef CONF_WITH_SHUTDOWN
 #  define CONF_WITH_SHUTDOWN 0
 # endif
+# ifndef CONF_WITH_BDOS_CACHE
+#  define CONF_WITH_BDOS_CACHE 0
+# endif
+# ifndef CONF_WITH_FAT_MAP
+#  define CONF_WITH_FAT_MAP 0
+# endif
+# ifndef CONF_WITH_EXTENT_MAP
+#  define CONF_WITH_EXTENT_MAP 0
+# endif
+# ifndef CONF_WITH_READAHEAD
+#  define CONF_WITH_READAHEAD 0
+# endif
+# ifndef CONF_WITH_LAZY_WRITEBACK
+#  define CONF_WITH_LAZY_WRITEBACK 0
+# endif
+# ifndef CONF_WITH_PREALLOC
+#  define CONF_WITH_PREALLOC 0
+# endif
+# ifndef CONF_WITH_FAT32
+#  define CONF_WITH_FAT32 0
+# endif
+# ifndef CONF_WITH_DIR_CACHE
+#  define CONF_WITH_DIR_CACHE 0
+# endif
+# ifndef CONF_WITH_FSLIST
+#  define CONF_WITH_FSLIST 0
+# endif
+# ifndef CONF_WITH_FCOPY
+#  define CONF_WITH_FCOPY 0
+# endif
+# ifndef CONF_WITH_PEXEC_CACHE
+#  define CONF_WITH_PEXEC_CACHE 0
+# endif
+# ifndef CONF_WITH_BESTFIT
+#  define CONF_WITH_BESTFIT 0
+# endif
+# ifndef CONF_WITH_OSMEM_SLABS
+#  define CONF_WITH_OSMEM_SLABS 0
+# endif
+# ifndef CONF_WITH_RAMDISK
+#  define CONF_WITH_RAMDISK 0
+# endif
+# ifndef CONF_WITH_FLOPPY_CACHE
+#  define CONF_WITH_FLOPPY_CACHE 0
+# endif
+# ifndef CONF_WITH_RWQUEUE
+#  define CONF_WITH_RWQUEUE 0
+# endif
 # ifndef MAX_VERTICES
 #  define MAX_VERTICES 512
 # endif
@@ -724,6 +868,14 @@
 # define CONF_WITH_VAMPIRE_SPI 0
 #endif
 
+/*
+ * Set CONF_WITH_SDMMC_CRC to 1 to check the CRC of each data block read
+ * from an SD/MMC card.  This costs some throughput.
+ */
+#ifndef CONF_WITH_SDMMC_CRC
+# define CONF_WITH_SDMMC_CRC 0
+#endif
+
 /*
  * Set CONF_WITH_ATARI_VIDEO to 1 to enable support for ST Shifter and higher
  */
@@ -1226,6 +1378,209 @@
 # define CONF_LOGSEC_SIZE 512
 #endif
 
+/*
+ * Set CONF_WITH_BDOS_CACHE to 1 to replace the two-buffer FAT and
+ * dir/data BCB chains with a larger sector cache.  Records are located
+ * via a hash table and the least recently used buffer is reused; the
+ * buffer lists at bufl[] are still maintained for compatibility.
+ */
+#ifndef CONF_WITH_BDOS_CACHE
+# define CONF_WITH_BDOS_CACHE 1
+#endif
+
+/*
+ * CONF_BDOS_BUFFERS is the default number of sector buffers in each of
+ * the two BCB lists when CONF_WITH_BDOS_CACHE is enabled.  It may be
+ * overridden at boot time via NVRAM (see bdos/fsbuf.c).  Each buffer
+ * uses about 32 bytes plus the maximum logical sector size, in Alt-RAM
+ * if that is available at boot, otherwise in ST-RAM.
+ */
+#ifndef CONF_BDOS_BUFFERS
+# define CONF_BDOS_BUFFERS 8
+#endif
+
+/*
+ * Set CONF_WITH_READAHEAD to 1 to detect files that are being read
+ * sequentially in small pieces, and to read the following records into
+ * the sector cache ahead of time, several at once.  The number of
+ * records read ahead adapts to how many of them actually get used.
+ * This requires CONF_WITH_BDOS_CACHE.
+ */
+#ifndef CONF_WITH_READAHEAD
+# define CONF_WITH_READAHEAD CONF_WITH_BDOS_CACHE
+#endif
+
+/*
+ * Set CONF_WITH_LAZY_WRITEBACK to 1 to write back dirty sector buffers
+ * from the VBL interrupt, once they have been dirty for more than
+ * CONF_WRITEBACK_AGE milliseconds.  This is only done when the interrupted
+ * code was in user mode, i.e. when neither the BDOS nor the BIOS is active.
+ * This requires CONF_WITH_BDOS_CACHE.
+ */
+#ifndef CONF_WITH_LAZY_WRITEBACK
+# define CONF_WITH_LAZY_WRITEBACK CONF_WITH_BDOS_CACHE
+#endif
+#ifndef CONF_WRITEBACK_AGE
+# define CONF_WRITEBACK_AGE 1000
+#endif
+
+/*
+ * Set CONF_WITH_FAT_MAP to 1 to keep a per-drive map of the parts of
+ * the FAT that contain no free clusters, plus a next-fit cursor.  This
+ * speeds up cluster allocation on large, nearly full partitions.  The
+ * map uses one block of internal OS memory per drive.
+ */
+#ifndef CONF_WITH_FAT_MAP
+# define CONF_WITH_FAT_MAP 1
+#endif
+
+/*
+ * Set CONF_WITH_EXTENT_MAP to 1 to remember the runs of contiguous
+ * clusters in an open file once they have been looked up.  Seeks and
+ * accesses within the mapped part of a file then no longer need to
+ * follow the FAT chain.  Each mapped file uses one block of internal
+ * OS memory while it is open.
+ */
+#ifndef CONF_WITH_EXTENT_MAP
+# define CONF_WITH_EXTENT_MAP 1
+#endif
+
+/*
+ * Set CONF_WITH_PREALLOC to 1 to allocate a contiguous run of clusters
+ * when a write extends a file, large enough for the whole write plus
+ * some room for growth.  This keeps files that are written at the same
+ * time from interleaving on the disk.  Clusters beyond the end of the
+ * file are freed again when the file is closed.
+ */
+#ifndef CONF_WITH_PREALLOC
+# define CONF_WITH_PREALLOC 1
+#endif
+
+/*
+ * Set CONF_WITH_FAT32 to 1 to support FAT32 partitions in the BIOS and
+ * BDOS.  Cluster numbers become 32 bits wide, the root directory of a
+ * FAT32 partition is a normal cluster chain, and the FSInfo sector is
+ * used to get the free cluster count without scanning the FAT.
+ */
+#ifndef CONF_WITH_FAT32
+# define CONF_WITH_FAT32 1
+#endif
+
+/*
+ * Set CONF_WITH_DIR_CACHE to 1 to cache the results of directory name
+ * lookups (including failed ones), so that opening files in large
+ * directories does not require scanning the directory every time.
+ */
+#ifndef CONF_WITH_DIR_CACHE
+# define CONF_WITH_DIR_CACHE 1
+#endif
+
+/*
+ * Set CONF_WITH_FSLIST to 1 to provide the Fslist() GEMDOS extension,
+ * which returns many directory entries per call, and to use it in the
+ * desktop, the file selector and EmuCON instead of Fsfirst()/Fsnext().
+ */
+#ifndef CONF_WITH_FSLIST
+# define CONF_WITH_FSLIST 1
+#endif
+
+/*
+ * Set CONF_WITH_FCOPY to 1 to provide the Fcopy() GEMDOS extension,
+ * which copies data between two open files inside the BDOS, and to use
+ * it for copying files in the desktop and EmuCON.
+ */
+#ifndef CONF_WITH_FCOPY
+# define CONF_WITH_FCOPY 1
+#endif
+
+/*
+ * Set CONF_WITH_PEXEC_CACHE to 1 to keep the images of recently loaded
+ * programs in Alt-RAM, so that loading the same program again does not
+ * need any disk access.  At most CONF_PEXEC_CACHE_SIZE Kbytes are used;
+ * the least recently used programs are discarded first.
+ */
+#ifndef CONF_WITH_PEXEC_CACHE
+# define CONF_WITH_PEXEC_CACHE CONF_WITH_ALT_RAM
+#endif
+#ifndef CONF_PEXEC_CACHE_SIZE
+# define CONF_PEXEC_CACHE_SIZE 1024
+#endif
+
+/*
+ * Set CONF_WITH_BESTFIT to 1 to provide the Mpolicy() GEMDOS extension,
+ * which allows Malloc() to use best-fit allocation instead of the TOS
+ * first-fit (the default), and to report the state of the free memory
+ * via Sstat().
+ */
+#ifndef CONF_WITH_BESTFIT
+# define CONF_WITH_BESTFIT 1
+#endif
+
+/*
+ * Set CONF_WITH_OSMEM_SLABS to 1 to let the internal BDOS memory pool
+ * (used for DNDs, OFDs, etc.) grow when it runs out, by adding slabs of
+ * CONF_OSMEM_SLAB_BLOCKS blocks from Alt-RAM, up to a maximum of
+ * CONF_OSMEM_MAX_SLABS slabs.  Slabs are never given back, so ST-RAM is
+ * not used: that would leave system blocks in the middle of the TPA.
+ * Otherwise, directory information must be discarded to make room, as
+ * in TOS.
+ */
+#ifndef CONF_WITH_OSMEM_SLABS
+# define CONF_WITH_OSMEM_SLABS CONF_WITH_ALT_RAM
+#endif
+#ifndef CONF_OSMEM_SLAB_BLOCKS
+# define CONF_OSMEM_SLAB_BLOCKS 32
+#endif
+#ifndef CONF_OSMEM_MAX_SLABS
+# define CONF_OSMEM_MAX_SLABS 16
+#endif
+
+/*
+ * Set CONF_WITH_RAMDISK to 1 to provide a RAM disk, as an additional
+ * hard disk unit.  Its size in Kbytes is set by CONF_RAMDISK_SIZE, unless
+ * overridden by the NVRAM or by the ramtos boot parameters (0 means no
+ * RAM disk).  If CONF_RAMDISK_KEEP is 1, its contents survive a warm reset.
+ */
+#ifndef CONF_WITH_RAMDISK
+# define CONF_WITH_RAMDISK 1
+#endif
+#ifndef CONF_RAMDISK_SIZE
+# define CONF_RAMDISK_SIZE 0
+#endif
+#ifndef CONF_RAMDISK_KEEP
+# define CONF_RAMDISK_KEEP 1
+#endif
+
+/*
+ * Set CONF_WITH_RWQUEUE to 1 to queue logical Rwabs() writes to hard
+ * disks in the BIOS.  When the queue is written out, the sectors are
+ * sorted and adjacent ones are merged into multi-sector transfers.  This
+ * happens when the queue is full, when a read overlaps it, before media
+ * change detection, when the BDOS flushes its buffers (e.g. Fclose()),
+ * at shutdown, and from the VBL interrupt once the oldest entry is
+ * CONF_RWQUEUE_AGE milliseconds old.  The queue holds
+ * CONF_RWQUEUE_SECTORS sectors of 512 bytes, in ST-RAM.
+ */
+#ifndef CONF_WITH_RWQUEUE
+# define CONF_WITH_RWQUEUE 1
+#endif
+#ifndef CONF_RWQUEUE_SECTORS
+# define CONF_RWQUEUE_SECTORS 32
+#endif
+#ifndef CONF_RWQUEUE_AGE
+# define CONF_RWQUEUE_AGE 100
+#endif
+
+/*
+ * Set CONF_WITH_FLOPPY_CACHE to 1 to keep the last track/side accessed
+ * by Rwabs() on each floppy drive in ST-RAM.  The first access to a track
+ * reads it completely, and the following reads are served from the copy.
+ * Writes go straight to the diskette, and also update the copy.
+ */
+#ifndef CONF_WITH_FLOPPY_CACHE
+# define CONF_WITH_FLOPPY_CACHE CONF_WITH_FDC
+#endif
+
 
 /****************************************************
  *  S O F T W A R E   S E C T I O N   -   V D I     *
@@ -1670,6 +2025,27 @@
 # endif
 #endif
 
+#if CONF_WITH_BDOS_CACHE
+# if (CONF_BDOS_BUFFERS < 2) || (CONF_BDOS_BUFFERS > 64)
+#  error CONF_BDOS_BUFFERS must be between 2 and 64.
+# endif
+#endif
+
+#if !CONF_WITH_BDOS_CACHE
+# if CONF_WITH_READAHEAD
+#  error CONF_WITH_READAHEAD requires CONF_WITH_BDOS_CACHE.
+# endif
+# if CONF_WITH_LAZY_WRITEBACK
+#  error CONF_WITH_LAZY_WRITEBACK requires CONF_WITH_BDOS_CACHE.
+# endif
+#endif
+
+#if !CONF_WITH_FDC
+# if CONF_WITH_FLOPPY_CACHE
+#  error CONF_WITH_FLOPPY_CACHE requires CONF_WITH_FDC.
+# endif
+#endif
+
 #if !CONF_WITH_YM2149
 # if CONF_WITH_FDC
 #  error CONF_WITH_FDC requires CONF_WITH_YM2149.
@@ -1680,6 +2056,12 @@
 # if CONF_WITH_STATIC_ALT_RAM
 #  error CONF_WITH_STATIC_ALT_RAM requires CONF_WITH_ALT_RAM.
 # endif
+# if CONF_WITH_PEXEC_CACHE
+#  error CONF_WITH_PEXEC_CACHE requires CONF_WITH_ALT_RAM.
+# endif
+# if CONF_WITH_OSMEM_SLABS
+#  error CONF_WITH_OSMEM_SLABS requires CONF_WITH_ALT_RAM.
+# endif
 #endif
 
 #ifndef STATIC_ALT_RAM_ADDRESS
@@ -67,6 +67,13 @@ static __inline__ WORD dos_snext(void)
     return Fsnext();
 }
 
+#if CONF_WITH_FSLIST
+static __inline__ LONG dos_slist(char *pspec, WORD attr, FSLIST *buf, LONG len)
+{
+    return Fslist(pspec,attr,buf,len);
+}
+#endif
+
 static __inline__ LONG dos_open(char *pname, WORD access)
 {
     return Fopen(pname,access);
@@ -92,6 +99,13 @@ static __inline__ LONG dos_lseek(WORD handle, WORD smode, LONG sofst)
     return Fseek(sofst, handle, smode);
 }
 
+#if CONF_WITH_FCOPY
+static __inline__ LONG dos_copy(WORD srchandle, WORD dsthandle, LONG cnt)
+{
+    return Fcopy(srchandle,dsthandle,cnt);
+}
+#endif
+
 static __inline__ LONG dos_chdir(char *pdrvpath)
 {
     return Dsetpath(pdrvpath);
@@ -0,0 +1,42 @@
+/*
+ * header.h - definitions for the TOS header
+ *
+ * This file was automatically generated by mkheader.awk on 2026-10-16
+ */
+
+#ifndef HEADER_H
+#define HEADER_H
+
+#include "i18nconf.h"
+#include "ctrycodes.h"
+
+/* The defines below must only be used in startup.S.
+ * Then the OS header variables must be used elsewhere.
+ * This allows tools like tos-lang-change to patch the ROM header afterwards.
+ */
+
+/* the year used in copyright notices */
+#define COPYRIGHT_YEAR "2026"
+
+/* the build date in Binary-Coded Decimal */
+#define OS_DATE 0x10162026
+
+/* the build date in GEMDOS format */
+#define OS_DOSDATE 23888
+
+/* the default country number */
+#define OS_COUNTRY COUNTRY_US
+
+/* the PAL/NTSC flag */
+#define OS_PAL 0
+
+/* the components of the internal version number */
+#define MAJOR_VERSION 1
+
+#define MINOR_VERSION 4
+
+#define FIX_VERSION 0
+
+#define UNOFFICIAL 1
+
+#endif /* HEADER_H */
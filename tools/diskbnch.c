@@ -0,0 +1,104 @@
+/*
+ * Quick & dirty Rwabs() sector throughput benchmark
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o DISKBNCH.TOS -Wall diskbnch.c
+ *
+ * Usage:
+ *      diskbnch drive [kbytes]
+ *
+ * Reads 'kbytes' (default 512) from the start of the specified drive
+ * with Rwabs(), once for each transfer size from 1 to 64 logical
+ * sectors, and shows the throughput for each size.  Nothing is written.
+ * This is meant to compare versions of a driver (e.g. for SD/MMC) on
+ * the same machine & media: run it a couple of times, since the first
+ * run may include a media change check.
+ *
+ * Copyright (C) 2026 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <time.h>
+#include <osbind.h>
+
+#define MAXCOUNT    64      /* maximum sectors per Rwabs() */
+
+/* as in EmuTOS include/biosdefs.h */
+typedef struct {
+    short recsiz;
+    short clsiz;
+    short clsizb;
+    short rdlen;
+    short fsiz;
+    short fatrec;
+    short datrec;
+    unsigned short numcl;
+    short b_flags;
+} BPB;
+
+int main(int argc, char *argv[]) {
+    BPB *bpb;
+    char *buf;
+    long kbytes = 512, total, rate, rc = 0;
+    int dev, count, sector, sectors;
+    clock_t start, ticks;
+
+    if ((argc < 2) || !isalpha((unsigned char)argv[1][0])) {
+        printf("Usage: diskbnch drive [kbytes]\r\n");
+        return 1;
+    }
+    dev = toupper((unsigned char)argv[1][0]) - 'A';
+    if (argc > 2)
+        kbytes = atol(argv[2]);
+
+    bpb = (BPB *)Getbpb(dev);
+    if (!bpb || (bpb->recsiz <= 0)) {
+        printf("Drive %c: is not available\r\n", 'A'+dev);
+        return 1;
+    }
+
+    /* stay within the first 32767 sectors, so that 'recno' is enough */
+    sectors = kbytes * 1024L / bpb->recsiz;
+    if ((sectors < MAXCOUNT) || (sectors > 32767 - MAXCOUNT)) {
+        printf("Invalid size: %ld Kbytes\r\n", kbytes);
+        return 1;
+    }
+    sectors -= sectors % MAXCOUNT;
+
+    buf = (char *)Malloc((long)MAXCOUNT * bpb->recsiz);
+    if (!buf) {
+        printf("Not enough memory\r\n");
+        return 1;
+    }
+
+    printf("Drive %c: reading %d sectors of %d bytes\r\n",
+        'A'+dev, sectors, bpb->recsiz);
+
+    for (count = 1; count <= MAXCOUNT; count *= 2) {
+        start = clock();
+        for (sector = 0; sector < sectors; sector += count) {
+            rc = Rwabs(0, buf, count, sector, dev);
+            if (rc < 0)
+                break;
+        }
+        ticks = clock() - start;
+        if (rc < 0) {
+            printf("Rwabs() error %ld at sector %d\r\n", rc, sector);
+            break;
+        }
+
+        total = (long)sectors * bpb->recsiz;
+        rate = ticks ? total / 1024L * CLOCKS_PER_SEC / ticks : 0L;
+        printf("%2d sectors per Rwabs(): %6ld ms, %5ld Kbytes/s\r\n",
+            count, (long)ticks * 1000L / CLOCKS_PER_SEC, rate);
+    }
+
+    Mfree(buf);
+
+    return (rc < 0) ? 1 : 0;
+}
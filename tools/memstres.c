@@ -4,6 +4,15 @@
  * Compile with:
  *      m68k-atari-mint-gcc -o MEMSTRES.TOS -Wall memstres.c
  *
+ * Usage:
+ *      memstres [blocks [first|best [cycles]]]
+ *
+ * If an allocation policy is given, it is selected via the EmuTOS
+ * Mpolicy() extension.  If a number of cycles is given, the test is
+ * run quietly for that many cycles, and the time taken and the state
+ * of the free memory (via Sstat()) are shown after each one, so that
+ * the policies can be compared.
+ *
  * Copyright 2016 Christian Zietz <czietz@gmx.net>
  *
  * This file is distributed under the GPL, version 2 or at your
@@ -12,6 +21,8 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #ifdef USE_STDLIB
 void* _Malloc(unsigned long s) {
@@ -21,16 +32,49 @@ int _Mfree(void *x) {
     free(x);
     return 0;
 }
+long _Mpolicy(int policy) {
+    return -32L;    /* EINVFN */
+}
+long _Sstat(int which, void *buf, long len) {
+    return -32L;    /* EINVFN */
+}
 #else
 #include <osbind.h>
 #define _Malloc Malloc
 #define _Mfree Mfree
+/* EmuTOS extensions */
+#define _Mpolicy(policy) (long)trap_1_ww((short)0x5b,(short)(policy))
+#define _Sstat(which,buf,len) (long)trap_1_wwll((short)0x58,(short)(which),(long)(buf),(long)(len))
 #endif
 
+/* as in EmuTOS include/bdosdefs.h */
+#define MP_FIRSTFIT 0
+#define MP_BESTFIT  1
+#define SS_MEMORY   3
+#define SS_RESET    0x8000
+
+typedef struct {
+    unsigned long mp_free;
+    unsigned long mp_largest;
+    unsigned short mp_nfree;
+    unsigned short mp_frag;
+} MPSTAT;
+
+typedef struct {
+    unsigned short ms_policy;
+    MPSTAT ms_st;
+    MPSTAT ms_alt;
+    unsigned long ms_allocs;
+    unsigned long ms_fails;
+    unsigned long ms_scanned;
+} MEMSTAT;
+
 #define MAX_SLOTS 1000
 void* g_slots[MAX_SLOTS] = {NULL};
 int g_slotsinuse = 0;
 int g_nslots = 0;
+int g_quiet = 0;
+unsigned long g_failed = 0;
 
 /* Quick & dirty (mostly) portable random generator, but still better than some C stdlib implementations */
 /* Idea is from Numerical Recipes in C, 2nd ed. */
@@ -72,13 +116,15 @@ int allocateslot(void) {
     /* allocate memory */
     size = getblocksize();
     g_slots[k] = (void *)_Malloc(size);
-    printf("Alloc %5ld bytes: %08lx\r\n", size, (unsigned long)g_slots[k]);
+    if (!g_quiet)
+        printf("Alloc %5ld bytes: %08lx\r\n", size, (unsigned long)g_slots[k]);
 
     /* check result */
     if (g_slots[k] != NULL) {
         g_slotsinuse++;
         return 1;
     } else {
+        g_failed++;
         return 0;
     }
 }
@@ -101,7 +147,8 @@ int freeslot(void) {
     }
 
     r = _Mfree(g_slots[k]);
-    printf("Free %08lx: %d\r\n", (unsigned long)g_slots[k], r);
+    if (!g_quiet)
+        printf("Free %08lx: %d\r\n", (unsigned long)g_slots[k], r);
 
     if (r==0) {
         g_slots[k] = NULL;
@@ -116,7 +163,32 @@ int randomwalk(unsigned char p) {
     return ((unsigned char)(qdrand() & 0xFF) < p);
 }
 
+/* show the state of the free memory, as seen by EmuTOS */
+void showstats(int cycle, clock_t ticks) {
+    MEMSTAT ms;
+
+    printf("Cycle %d: %ld ms, %lu failed allocations\r\n",
+        cycle, (long)ticks * 1000L / CLOCKS_PER_SEC, g_failed);
+
+    if (_Sstat(SS_MEMORY|SS_RESET, &ms, sizeof(ms)) != sizeof(ms)) {
+        printf("  (no memory statistics available)\r\n");
+        return;
+    }
+
+    printf("  ST-RAM: %lu free in %u blocks, largest %lu, fragmentation %u.%u%%\r\n",
+        ms.ms_st.mp_free, ms.ms_st.mp_nfree, ms.ms_st.mp_largest,
+        ms.ms_st.mp_frag / 10, ms.ms_st.mp_frag % 10);
+    if (ms.ms_alt.mp_free)
+        printf("  Alt-RAM: %lu free in %u blocks, largest %lu, fragmentation %u.%u%%\r\n",
+            ms.ms_alt.mp_free, ms.ms_alt.mp_nfree, ms.ms_alt.mp_largest,
+            ms.ms_alt.mp_frag / 10, ms.ms_alt.mp_frag % 10);
+    printf("  %lu allocations, %lu failed despite enough free memory, %lu free blocks examined\r\n",
+        ms.ms_allocs, ms.ms_fails, ms.ms_scanned);
+}
+
 int main(int argc, char* argv[]) {
+    int cycles = 0, cycle;
+    clock_t start;
 
     /* allow the user to give the number of blocks to allocate */
     if (argc < 2) {
@@ -132,8 +204,29 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    while (1) {
-        printf("ALLOC PHASE\r\n");
+    /* allocation policy */
+    if (argc >= 3) {
+        int policy = strcmp(argv[2], "best") ? MP_FIRSTFIT : MP_BESTFIT;
+
+        if (_Mpolicy(policy) < 0) {
+            printf("Mpolicy() is not supported\r\n");
+            return 1;
+        }
+        printf("Using %s-fit allocation\r\n", policy == MP_BESTFIT ? "best" : "first");
+    }
+
+    /* number of cycles, for benchmarking */
+    if (argc >= 4) {
+        cycles = atoi(argv[3]);
+        g_quiet = 1;
+        _Sstat(SS_MEMORY|SS_RESET, NULL, 0L);
+    }
+
+    for (cycle = 1; !cycles || (cycle <= cycles); cycle++) {
+        start = clock();
+
+        if (!g_quiet)
+            printf("ALLOC PHASE\r\n");
         while (g_slotsinuse < g_nslots) {
             /* on average 75% allocation, 25% free */
             if (randomwalk(192)) {
@@ -143,7 +236,12 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        printf("\r\nFREE PHASE\r\n");
+        /* this is where the memory is most fragmented */
+        if (g_quiet)
+            showstats(cycle, clock() - start);
+
+        if (!g_quiet)
+            printf("\r\nFREE PHASE\r\n");
         while (g_slotsinuse > 0) {
             /* on average 75% free, 25% alloc */
             if (randomwalk(64)) {
@@ -153,6 +251,9 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        printf("\r\n");
+        if (!g_quiet)
+            printf("\r\n");
     }
+
+    return 0;
 }